@@ -0,0 +1,425 @@
+/*
+**  Host build of the game, for profiling and regression runs without a
+**  board. Build and run from the top of the repo:
+**
+**      make host
+**      TJ_FRAMES=20000 ./tj_host
+**
+**  Time is simulated: an 8 MHz cycle counter moves on when the game
+**  waits or finishes a frame, and fires the timer 0, timer 1, timer 3
+**  and ADC interrupts from the prescalers set in their registers. The
+**  game itself runs flat out, so thousands of frames take well under a
+**  second. With the same settings every run is identical.
+**
+**  Settings come from the environment:
+**    TJ_FRAMES    frames to run before reporting and exiting (10000)
+**    TJ_FRAME_US  simulated time each frame takes (20000)
+**    TJ_SEED      seed for the input autopilot (1)
+**    TJ_WHEEL_L   left and right potentiometer readings, 0-1023 (512)
+**    TJ_WHEEL_R
+**    TJ_USB_IN    file fed to the USB serial port, 64 bytes per ms
+**    TJ_USB_OUT   file that receives what the game sends over USB
+**    TJ_DUMP      if set, draw the LCD on stderr at exit
+**
+**  With no one at the buttons an autopilot plays: it wanders Jerry about
+**  with the joystick, fires now and then, and presses the right button
+**  whenever the game sits waiting for it.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+
+#define HOST_CPU_HZ 8000000
+#define HOST_CYCLES_PER_US (HOST_CPU_HZ / 1000000)
+#define HOST_USB_BYTES_PER_MS 64 // one full speed packet per USB frame
+#define HOST_WAIT_PRESS_MS 500 // idle this long and the autopilot presses R
+#define HOST_PRESS_MS 200 // long enough for the debounce to see it
+#define HOST_NEVER UINT64_MAX
+
+volatile uint8_t PORTB, PORTC, PORTD, PORTF;
+volatile uint8_t PINB, PINC, PIND, PINF;
+volatile uint8_t DDRB, DDRC, DDRD, DDRF;
+volatile uint8_t TCCR0A, TCCR0B, TIMSK0, TCNT0;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint8_t TCCR3A, TCCR3B, TIMSK3;
+volatile uint16_t TCNT1, TCNT3, OCR3A;
+volatile uint8_t ADMUX, ADCSRA, ADCSRB;
+volatile uint16_t ADC;
+volatile uint8_t host_interrupts;
+
+uint8_t screen_buffer[LCD_BUFFER_SIZE];
+
+// Simulated clock
+uint64_t host_cycles;
+uint64_t host_next[4]; // next firing of each interrupt source, HOST_NEVER if off
+uint64_t host_fired[4];
+uint8_t host_adc_channel; // channel the running conversion samples
+uint16_t host_wheel[2];
+enum {HOST_T0, HOST_T1, HOST_T3, HOST_ADC};
+
+// LCD: display RAM and the controller's address pointer
+uint8_t lcd_ram[LCD_BUFFER_SIZE];
+uint8_t lcd_x, lcd_bank, lcd_extended;
+uint64_t lcd_data_bytes;
+
+// USB
+uint8_t usb_started;
+uint8_t* usb_in;
+long usb_in_size, usb_in_pos;
+uint64_t usb_in_from; // cycle count when the input started arriving
+FILE* usb_out;
+uint64_t usb_out_bytes;
+
+// Run control and the autopilot
+long host_frames, host_frame_limit;
+uint32_t host_frame_us;
+uint32_t host_rand;
+uint32_t host_idle_ms;
+uint32_t host_press_ms; // time left on the autopilot's R press
+uint32_t host_stick_ms, host_fire_ms;
+uint8_t host_stick; // joystick direction held, 0-3, 4 for none
+int host_dump;
+clock_t host_start;
+
+long env_long(const char* name, long fallback) {
+	const char* value = getenv(name);
+	return value ? strtol(value, NULL, 0) : fallback;
+}
+
+uint32_t host_random() {
+	host_rand = host_rand * 1103515245 + 12345;
+	return host_rand >> 16;
+}
+
+void host_start_up() {
+	if (host_frame_limit) return;
+	host_frame_limit = env_long("TJ_FRAMES", 10000);
+	host_frame_us = env_long("TJ_FRAME_US", 20000);
+	host_rand = env_long("TJ_SEED", 1);
+	host_wheel[0] = env_long("TJ_WHEEL_L", 512) & 0x3FF;
+	host_wheel[1] = env_long("TJ_WHEEL_R", 512) & 0x3FF;
+	host_dump = getenv("TJ_DUMP") != NULL;
+	host_stick = 4;
+	for (int i = 0; i < 4; i++) host_next[i] = HOST_NEVER;
+
+	const char* path = getenv("TJ_USB_IN");
+	FILE* in = path ? fopen(path, "rb") : NULL;
+	if (in) {
+		fseek(in, 0, SEEK_END);
+		usb_in_size = ftell(in);
+		rewind(in);
+		usb_in = malloc(usb_in_size);
+		usb_in_size = fread(usb_in, 1, usb_in_size, in);
+		fclose(in);
+	}
+	path = getenv("TJ_USB_OUT");
+	if (path) usb_out = fopen(path, "wb");
+	host_start = clock();
+}
+
+void set_clock_speed(uint8_t speed) {
+	(void)speed;
+	host_start_up();
+}
+
+/*
+**	Interrupt sources
+*/
+uint32_t prescale(uint8_t clock_select) {
+	static const uint16_t divide[8] = {0, 1, 8, 64, 256, 1024, 0, 0}; // 6, 7: external clock
+	return divide[clock_select & 7];
+}
+
+// Cycles between interrupts from a source as set up now, 0 if it is off
+uint64_t host_period(int source) {
+	switch (source) {
+	case HOST_T0:
+		if (!BIT_IS_SET(TIMSK0, TOIE0)) return 0;
+		return 256 * prescale(TCCR0B);
+	case HOST_T1:
+		if (!BIT_IS_SET(TIMSK1, TOIE1)) return 0;
+		return 65536 * prescale(TCCR1B);
+	case HOST_T3:
+		if (!BIT_IS_SET(TIMSK3, OCIE3A) || !BIT_IS_SET(TCCR3B, WGM32)) return 0;
+		return (OCR3A + 1) * prescale(TCCR3B);
+	default: // ADC: 13 ADC clocks a conversion, free running only
+		if (!BIT_IS_SET(ADCSRA, ADEN) || !BIT_IS_SET(ADCSRA, ADIE) || !BIT_IS_SET(ADCSRA, ADATE)) return 0;
+		if (!BIT_IS_SET(ADCSRA, ADSC) && host_next[HOST_ADC] == HOST_NEVER) return 0; // not started
+		return 13 * (2 << ((ADCSRA & 7) ? (ADCSRA & 7) - 1 : 0));
+	}
+}
+
+void host_fire(int source) {
+	host_fired[source]++;
+	switch (source) {
+	case HOST_T0: TIMER0_OVF_vect(); break;
+	case HOST_T1: TIMER1_OVF_vect(); break;
+	case HOST_T3: TIMER3_COMPA_vect(); break;
+	default:
+		ADC = host_wheel[host_adc_channel & 1];
+		host_adc_channel = ADMUX & 0x1F; // the next conversion has started
+		ADC_vect();
+		break;
+	}
+}
+
+// Buttons read from the pins by the timer 1 interrupt
+void host_drive_inputs(uint32_t ms) {
+	uint8_t stick = 4, fire = 0, right = 0;
+
+	if (host_press_ms) {
+		right = 1;
+		host_press_ms = (host_press_ms > ms) ? host_press_ms - ms : 0;
+	}
+	if (host_stick_ms > ms) host_stick_ms -= ms;
+	else {
+		host_stick = host_random() % 6; // 4 and 5: let go
+		host_stick_ms = 100 + host_random() % 600;
+	}
+	if (host_stick < 4) stick = host_stick;
+	if (host_fire_ms > ms) host_fire_ms -= ms;
+	else host_fire_ms = 1000 + host_random() % 2000;
+	fire = host_fire_ms < HOST_PRESS_MS;
+
+	WRITE_BIT(PIND, 1, stick == 0); // up
+	WRITE_BIT(PINB, 7, stick == 1); // down
+	WRITE_BIT(PINB, 1, stick == 2); // left
+	WRITE_BIT(PIND, 0, stick == 3); // right
+	WRITE_BIT(PINB, 0, fire && !host_idle_ms); // centre, only in play
+	WRITE_BIT(PINF, 5, right); // SW2
+	PINF &= ~(1 << 6); // SW1 never: it skips the level
+}
+
+// Let simulated time pass, running the interrupts that fall due
+void host_advance(uint32_t us) {
+	uint64_t end = host_cycles + (uint64_t)us * HOST_CYCLES_PER_US;
+
+	host_drive_inputs(us / 1000);
+	while (1) {
+		int next = -1;
+		for (int i = 0; i < 4; i++) {
+			uint64_t period = host_period(i);
+			if (!period) host_next[i] = HOST_NEVER;
+			else if (host_next[i] == HOST_NEVER) host_next[i] = host_cycles + period;
+			if (host_next[i] != HOST_NEVER && (next < 0 || host_next[i] < host_next[next])) next = i;
+		}
+		if (!host_interrupts || next < 0 || host_next[next] > end) break;
+		host_cycles = host_next[next];
+		host_next[next] += host_period(next);
+		host_fire(next);
+	}
+	host_cycles = end;
+	TCNT1 = host_cycles / (prescale(TCCR1B) ? prescale(TCCR1B) : 1);
+	TCNT0 = host_cycles / (prescale(TCCR0B) ? prescale(TCCR0B) : 1);
+}
+
+void hal_delay_us(uint32_t us) {
+	host_advance(us);
+}
+
+void hal_idle() {
+	host_start_up();
+	host_idle_ms++;
+	if (host_idle_ms >= HOST_WAIT_PRESS_MS && !host_press_ms) {
+		host_press_ms = HOST_PRESS_MS;
+		host_idle_ms = 1;
+	}
+	host_advance(1000);
+}
+
+/*
+**	LCD
+*/
+void lcd_write(uint8_t dc, uint8_t data) {
+	if (dc == LCD_D) {
+		lcd_ram[lcd_bank * LCD_X + lcd_x] = data;
+		lcd_data_bytes++;
+		if (++lcd_x == LCD_X) {
+			lcd_x = 0;
+			if (++lcd_bank == LCD_Y / 8) lcd_bank = 0;
+		}
+	} else if ((data & 0xF8) == lcd_set_function) {
+		lcd_extended = data & lcd_instr_extended;
+	} else if (!lcd_extended && (data & lcd_set_x_addr)) {
+		lcd_x = (data & 0x7F) % LCD_X;
+	} else if (!lcd_extended && (data & 0xF8) == lcd_set_y_addr) {
+		lcd_bank = (data & 7) % (LCD_Y / 8);
+	}
+}
+
+void lcd_position(uint8_t x, uint8_t y) {
+	LCD_CMD(lcd_set_x_addr, x);
+	LCD_CMD(lcd_set_y_addr, y);
+}
+
+void lcd_clear(void) {
+	lcd_position(0, 0);
+	for (int i = 0; i < LCD_BUFFER_SIZE; i++) LCD_DATA(0);
+}
+
+void lcd_init(uint8_t contrast) {
+	LCD_CMD(lcd_set_function, lcd_instr_extended);
+	LCD_CMD(lcd_set_contrast, contrast);
+	LCD_CMD(lcd_set_function, lcd_instr_basic);
+	lcd_clear();
+}
+
+// Print the LCD as text, one character per pixel
+void host_dump_lcd(FILE* out) {
+	for (int y = 0; y < LCD_Y; y++) {
+		for (int x = 0; x < LCD_X; x++) {
+			fputc(BIT_IS_SET(lcd_ram[(y >> 3) * LCD_X + x], y & 7) ? '#' : '.', out);
+		}
+		fputc('\n', out);
+	}
+}
+
+/*
+**	Graphics
+*/
+void show_screen(void) {
+	lcd_position(0, 0);
+	for (int i = 0; i < LCD_BUFFER_SIZE; i++) LCD_DATA(screen_buffer[i]);
+}
+
+void clear_screen(void) {
+	memset(screen_buffer, 0, sizeof(screen_buffer));
+}
+
+void draw_pixel(int x, int y, colour_t colour) {
+	if (x < 0 || x >= LCD_X || y < 0 || y >= LCD_Y) return;
+	WRITE_BIT(screen_buffer[(y >> 3) * LCD_X + x], y & 7, colour == FG_COLOUR);
+}
+
+void draw_line(int x1, int y1, int x2, int y2, colour_t colour) {
+	if ( x1 == x2 ) {
+		for ( int i = y1; (y2 > y1) ? i <= y2 : i >= y2; (y2 > y1) ? i++ : i-- ) {
+			draw_pixel(x1, i, colour);
+		}
+	}
+	else if ( y1 == y2 ) {
+		for ( int i = x1; (x2 > x1) ? i <= x2 : i >= x2; (x2 > x1) ? i++ : i-- ) {
+			draw_pixel(i, y1, colour);
+		}
+	}
+	else {
+		if ( x1 > x2 ) {
+			int t = x1;
+			x1 = x2;
+			x2 = t;
+			t = y1;
+			y1 = y2;
+			y2 = t;
+		}
+
+		float dx = x2 - x1;
+		float dy = y2 - y1;
+		float err = 0.0;
+		float derr = ABS(dy / dx);
+
+		for ( int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x-- ) {
+			draw_pixel(x, y, colour);
+			err += derr;
+			while ( err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2) ) {
+				draw_pixel(x, y, colour);
+				y += (dy > 0) - (dy < 0);
+				err -= 1.0;
+			}
+		}
+	}
+}
+
+void draw_char(int x, int y, char character, colour_t colour) {
+	(void)x; (void)y; (void)character; (void)colour;
+}
+
+void draw_string(int x, int y, char* text, colour_t colour) {
+	for (; *text; text++, x += CHAR_WIDTH) draw_char(x, y, *text, colour);
+}
+
+/*
+**	USB serial. Input arrives at full speed from when the port is opened.
+*/
+void usb_init(void) {
+	host_start_up();
+	usb_started = 1;
+	usb_in_from = host_cycles;
+}
+
+uint8_t usb_configured(void) {
+	return usb_started;
+}
+
+uint8_t usb_serial_get_control(void) {
+	return usb_started;
+}
+
+long usb_arrived() {
+	if (!usb_started) return 0;
+	long arrived = (host_cycles - usb_in_from) / (HOST_CYCLES_PER_US * 1000) * HOST_USB_BYTES_PER_MS;
+	return (arrived < usb_in_size) ? arrived : usb_in_size;
+}
+
+uint8_t usb_serial_available(void) {
+	long waiting = usb_arrived() - usb_in_pos;
+	return (waiting > 255) ? 255 : (waiting > 0) ? waiting : 0;
+}
+
+int16_t usb_serial_getchar(void) {
+	if (usb_in_pos >= usb_arrived()) return -1;
+	return usb_in[usb_in_pos++];
+}
+
+void usb_serial_flush_input(void) {
+	if (usb_in_pos < usb_arrived()) usb_in_pos = usb_arrived();
+}
+
+int8_t usb_serial_putchar(uint8_t c) {
+	usb_out_bytes++;
+	if (usb_out) fputc(c, usb_out);
+	return 0;
+}
+
+int8_t usb_serial_putchar_nowait(uint8_t c) {
+	return usb_serial_putchar(c);
+}
+
+int8_t usb_serial_write(const uint8_t* buffer, uint16_t size) {
+	while (size--) usb_serial_putchar(*buffer++);
+	return 0;
+}
+
+void usb_serial_flush_output(void) {
+	if (usb_out) fflush(usb_out);
+}
+
+/*
+**	Run control
+*/
+void host_report() {
+	double host_s = (double)(clock() - host_start) / CLOCKS_PER_SEC;
+	double frames = host_frames ? host_frames : 1;
+	fprintf(stderr, "frames %ld in %.2f s simulated, %.3f s host, %.0f frames/s\n",
+		host_frames, host_cycles / (double)HOST_CPU_HZ, host_s, host_frames / (host_s > 0 ? host_s : 1e-9));
+	fprintf(stderr, "lcd %.1f bytes/frame, usb out %llu bytes, usb in %ld of %ld bytes\n",
+		lcd_data_bytes / frames, (unsigned long long)usb_out_bytes, usb_in_pos, usb_in_size);
+	fprintf(stderr, "interrupts: timer0 %llu, timer1 %llu, timer3 %llu, adc %llu\n",
+		(unsigned long long)host_fired[HOST_T0], (unsigned long long)host_fired[HOST_T1],
+		(unsigned long long)host_fired[HOST_T3], (unsigned long long)host_fired[HOST_ADC]);
+	if (host_dump) host_dump_lcd(stderr);
+}
+
+void hal_frame() {
+	host_start_up();
+	host_idle_ms = 0;
+	host_advance(host_frame_us);
+	if (++host_frames >= host_frame_limit) {
+		host_report();
+		if (usb_out) fclose(usb_out);
+		exit(0);
+	}
+}
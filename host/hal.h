@@ -0,0 +1,208 @@
+/*
+**  Host stand-ins for the board, used when tj.c is built with -DHOST.
+**
+**  Covers what tj.c takes from avr-libc, cpu_speed.h, macros.h, lcd.h,
+**  lcd_model.h, graphics.h and usb_serial.h. The I/O registers are plain
+**  variables, the LCD, buttons, wheels and USB are in-memory fakes, and
+**  the timer and ADC interrupts are run from a simulated clock whenever
+**  the game waits (hal_idle, _delay_ms) or finishes a frame (hal_frame).
+**  See hal.c.
+*/
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+
+/*
+**	avr/io.h: I/O registers and the bits tj.c uses
+*/
+extern volatile uint8_t PORTB, PORTC, PORTD, PORTF;
+extern volatile uint8_t PINB, PINC, PIND, PINF;
+extern volatile uint8_t DDRB, DDRC, DDRD, DDRF;
+extern volatile uint8_t TCCR0A, TCCR0B, TIMSK0, TCNT0;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint8_t TCCR3A, TCCR3B, TIMSK3;
+extern volatile uint16_t TCNT1, TCNT3, OCR3A;
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB;
+extern volatile uint16_t ADC;
+
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+#define TOIE0 0
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define TOIE1 0
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define WGM32 3
+#define WGM33 4
+#define OCIE3A 1
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+
+/*
+**	avr/interrupt.h, util/atomic.h: ISRs are ordinary functions called by
+**  the simulated clock, which only runs between statements of the main
+**  loop, so an atomic block needs no locking.
+*/
+extern volatile uint8_t host_interrupts;
+#define ISR(vector) void vector(void)
+#define sei() (host_interrupts = 1)
+#define cli() (host_interrupts = 0)
+#define ATOMIC_BLOCK(type) for (uint8_t host_once_ = 1; host_once_; host_once_ = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+void TIMER0_OVF_vect(void);
+void TIMER1_OVF_vect(void);
+void TIMER3_COMPA_vect(void);
+void ADC_vect(void);
+
+/*
+**	avr/pgmspace.h: flash is ordinary memory
+*/
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_ptr(p) (*(const void* const*)(p))
+#define memcpy_P memcpy
+
+/*
+**	util/crc16.h
+*/
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+	data ^= crc & 0xFF;
+	data ^= data << 4;
+	return (((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3);
+}
+
+/*
+**	util/delay.h, cpu_speed.h: delays move the simulated clock on
+*/
+void hal_delay_us(uint32_t us);
+#define _delay_ms(ms) hal_delay_us((uint32_t)((ms) * 1000))
+#define _delay_us(us) hal_delay_us((uint32_t)(us))
+#define CPU_8MHz 0x01
+void set_clock_speed(uint8_t speed);
+
+/*
+**	macros.h
+*/
+#define SET_BIT(reg, pin) (reg) |= (1 << (pin))
+#define CLEAR_BIT(reg, pin) (reg) &= ~(1 << (pin))
+#define WRITE_BIT(reg, pin, value) (reg) = (((reg) & ~(1 << (pin))) | ((value) << (pin)))
+#define BIT_VALUE(reg, pin) (((reg) >> (pin)) & 1)
+#define BIT_IS_SET(reg, pin) (BIT_VALUE((reg),(pin))==1)
+#define SET_INPUT(reg, pin) CLEAR_BIT(reg, pin)
+#define SET_OUTPUT(reg, pin) SET_BIT(reg, pin)
+#define ABS(x) (((x) >= 0) ? (x) : -(x))
+#define LOW 0
+#define HIGH 1
+
+/*
+**	lcd.h, lcd_model.h: a PCD8544 fed through lcd_write()
+*/
+#define LCD_X 84
+#define LCD_Y 48
+#define LCD_DEFAULT_CONTRAST 0x3F
+#define SCEPIN 7
+#define RSTPIN 4
+#define DCPIN 5
+#define DINPIN 6
+#define SCKPIN 7
+#define LCD_C LOW
+#define LCD_D HIGH
+
+typedef enum {
+	lcd_set_function = 0x20,
+	lcd_set_display_mode = 0x08,
+	lcd_set_temp_coeff = 0x04,
+	lcd_set_bias = 0x10,
+	lcd_set_y_addr = 0x40,
+	lcd_set_x_addr = 0x80,
+	lcd_set_contrast = 0x80,
+} lcd_cmd;
+
+enum {
+	lcd_instr_basic = 0,
+	lcd_instr_extended = 1,
+	lcd_addressing_horizontal = 0,
+	lcd_addressing_vertical = 2,
+	lcd_display_normal = 4,
+};
+
+#define LCD_CMD(cmd, data) lcd_write(LCD_C, (cmd) | (data))
+#define LCD_DATA(data) lcd_write(LCD_D, (data))
+
+void lcd_init(uint8_t contrast);
+void lcd_write(uint8_t dc, uint8_t data);
+void lcd_clear(void);
+void lcd_position(uint8_t x, uint8_t y);
+
+/*
+**	graphics.h. There is no font on the host, text is not drawn.
+*/
+#define LCD_BUFFER_SIZE (LCD_X * (LCD_Y / 8))
+#define CHAR_WIDTH 5
+#define CHAR_HEIGHT 8
+
+typedef enum colour_t {
+	BG_COLOUR = 0,
+	FG_COLOUR = 1,
+} colour_t;
+
+extern uint8_t screen_buffer[LCD_BUFFER_SIZE];
+void show_screen(void);
+void clear_screen(void);
+void draw_pixel(int x, int y, colour_t colour);
+void draw_line(int x1, int y1, int x2, int y2, colour_t colour);
+void draw_char(int x, int y, char character, colour_t colour);
+void draw_string(int x, int y, char* text, colour_t colour);
+
+/*
+**	usb_serial.h
+*/
+void usb_init(void);
+uint8_t usb_configured(void);
+int16_t usb_serial_getchar(void);
+uint8_t usb_serial_available(void);
+void usb_serial_flush_input(void);
+int8_t usb_serial_putchar(uint8_t c);
+int8_t usb_serial_putchar_nowait(uint8_t c);
+int8_t usb_serial_write(const uint8_t* buffer, uint16_t size);
+void usb_serial_flush_output(void);
+uint8_t usb_serial_get_control(void);
+
+/*
+**	Hooks the game calls. On the board they are empty.
+*/
+void hal_idle(void); // inside a busy wait: let 1 ms of simulated time pass
+void hal_frame(void); // once per pass of the main loop
+
+/*
+**	For host programs that drive the game themselves (tests/)
+*/
+extern uint8_t lcd_ram[LCD_BUFFER_SIZE]; // what the LCD is showing
+void host_advance(uint32_t us); // let time pass, running due interrupts
+void host_dump_lcd(FILE* out);
+
+#endif
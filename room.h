@@ -0,0 +1,108 @@
+/*
+**  Room layout shared by tj.c and roomc.c: the limits a room is checked
+**  against, the binary room format and the wall rasteriser, so the game
+**  and the offline compiler cannot drift apart.
+**
+**  The includer provides the wall_mask array (LCD_BUFFER_SIZE bytes, LCD
+**  bank layout). LCD_X and LCD_Y come from lcd.h on the board; roomc has
+**  no LCD headers and gets the PCD8544 size below.
+*/
+#ifndef ROOM_H_
+#define ROOM_H_
+
+#include <stdint.h>
+
+#ifndef LCD_X
+#define LCD_X 84
+#define LCD_Y 48
+#endif
+#ifndef LCD_BUFFER_SIZE
+#define LCD_BUFFER_SIZE (LCD_X * (LCD_Y / 8))
+#endif
+#ifndef ABS
+#define ABS(x) (((x) >= 0) ? (x) : -(x))
+#endif
+
+#define GAME_CEILING 10
+#define MAX_WALLS 6
+#define MAX_CHAR_WIDTH 5 // max px width of Tom or Jerry
+#define MAX_CHAR_HEIGHT 7 // max px height of Tom or Jerry
+
+#define GRID_CELL 4 // px per side of a free-space grid cell
+#define GRID_COLS (LCD_X / GRID_CELL)
+#define GRID_ROWS (LCD_Y / GRID_CELL)
+#define GRID_TOP ((GAME_CEILING + GRID_CELL - 1) / GRID_CELL) // first row below the status bar
+
+#define ROOM_VERSION 1 // binary room format, 0 ends a pack
+#define ROOM_HAS_MASK 1 // flag: a precomputed wall mask follows the walls
+#define ROOM_HEADER 7 // version, flags, wall count, Tom x y, Jerry x y
+
+/*
+**  A room in a pack: ROOM() header then wall_count ROOM_WALL()s of signed
+**  bytes, then the wall mask if ROOM_HAS_MASK. Tom and Jerry are whole
+**  pixels, x in 0..LCD_X - MAX_CHAR_WIDTH and y in GAME_CEILING..LCD_Y -
+**  MAX_CHAR_HEIGHT.
+*/
+#define ROOM(flags, walls, tom_x, tom_y, jerry_x, jerry_y) ROOM_VERSION, flags, walls, tom_x, tom_y, jerry_x, jerry_y
+#define ROOM_WALL(x1, y1, x2, y2) (uint8_t)(x1), (uint8_t)(y1), (uint8_t)(x2), (uint8_t)(y2)
+
+extern uint8_t wall_mask[LCD_BUFFER_SIZE];
+
+// Set or clear one pixel of the wall mask
+static void write_wall_pixel(int x, int y, uint8_t value) {
+	if (x < 0 || x >= LCD_X || y < 0 || y >= LCD_Y) return;
+	if (value) wall_mask[(y >> 3) * LCD_X + x] |= 1 << (y & 7);
+	else wall_mask[(y >> 3) * LCD_X + x] &= ~(1 << (y & 7));
+}
+
+// Modified version of draw_line from graphics.c
+// Rasterise one wall into the wall mask
+static void raster_wall(int line[], uint8_t value) {
+	int x1 = line[0];
+	int y1 = line[1];
+	int x2 = line[2];
+	int y2 = line[3];
+
+	if ( x1 == x2 ) {
+		// Draw vertical line
+		for ( int i = y1; (y2 > y1) ? i <= y2 : i >= y2; (y2 > y1) ? i++ : i-- ) {
+			write_wall_pixel(x1, i, value);
+		}
+	}
+	else if ( y1 == y2 ) {
+		// Draw horizontal line
+		for ( int i = x1; (x2 > x1) ? i <= x2 : i >= x2; (x2 > x1) ? i++ : i-- ) {
+			write_wall_pixel(i, y1, value);
+		}
+	}
+	else {
+		//	Always draw from left to right, regardless of the order the endpoints are
+		//	presented.
+		if ( x1 > x2 ) {
+			int t = x1;
+			x1 = x2;
+			x2 = t;
+			t = y1;
+			y1 = y2;
+			y2 = t;
+		}
+
+		// Get Bresenhaming...
+		float dx = x2 - x1;
+		float dy = y2 - y1;
+		float err = 0.0;
+		float derr = ABS(dy / dx);
+
+		for ( int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x-- ) {
+			write_wall_pixel(x, y, value);
+			err += derr;
+			while ( err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2) ) {
+				write_wall_pixel(x, y, value);
+				y += (dy > 0) - (dy < 0);
+				err -= 1.0;
+			}
+		}
+	}
+}
+
+#endif
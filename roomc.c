@@ -0,0 +1,240 @@
+/*
+**  roomc - offline room compiler for tj.c
+**
+**  Reads rooms in the same text records the game takes over USB and
+**  writes a level pack in the binary room format, with the walls
+**  rasterised here instead of on the device. Records:
+**
+**    T x y             Tom's start position
+**    J x y             Jerry's start position
+**    W x1 y1 x2 y2     a wall (at most MAX_WALLS per room)
+**    E                 end of room
+**    # ...             comment; the last one before a room names it
+**
+**  Records are checked the way room_end_record() in tj.c checks them,
+**  on the whole part of each number. T and J take fractions as the game
+**  does ("T 10.5 20"), but the pack holds whole pixels, so only the whole
+**  part is kept.
+**
+**  Each room is written as the 7 byte header and the walls. With -m
+**  (ROOM_HAS_MASK) the rasterised wall mask follows, LCD_BUFFER_SIZE
+**  bytes in LCD bank layout, and room_unpack() copies it from flash
+**  instead of drawing the walls.
+**
+**  The pack ends with a 0 byte. Output is C, ROOM() and ROOM_WALL() from
+**  room.h with the mask as hex (default), or the raw bytes (-b).
+**
+**  Build and run on the host (see the Makefile):
+**      make roomc
+**      ./roomc -m -n level_pack rooms.txt > level_pack.h
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "room.h"
+
+#define MAX_LINE 128
+#define MAX_NAME 48
+
+typedef struct {
+	int walls[MAX_WALLS][4];
+	int wall_count;
+	int tom[2];
+	int jerry[2];
+	int has_tom, has_jerry;
+	char name[MAX_NAME]; // from the comment before it
+} Room;
+
+// The room's walls, rasterised
+uint8_t wall_mask[LCD_BUFFER_SIZE];
+
+// Output
+int raw; // -b: raw bytes instead of C
+uint8_t room_flags; // sections to write, from -m
+const char* pack_name = "level_pack";
+long pack_bytes;
+int line_bytes; // bytes on the current line of C output
+
+void emit(uint8_t byte) {
+	pack_bytes++;
+	if (raw) {
+		putchar(byte);
+		return;
+	}
+	if (line_bytes == 0) printf("\t");
+	printf("0x%02X,", byte);
+	if (++line_bytes == 16) {
+		printf("\n");
+		line_bytes = 0;
+	}
+}
+
+void emit_break(const char* comment) {
+	if (raw) return;
+	if (line_bytes) printf("\n");
+	line_bytes = 0;
+	if (comment) printf("\t// %s\n", comment);
+}
+
+// The flags as C, for ROOM()
+const char* flag_names(uint8_t flags) {
+	return (flags & ROOM_HAS_MASK) ? "ROOM_HAS_MASK" : "0";
+}
+
+// Header and walls, as ROOM() and ROOM_WALL() in C
+void emit_room(Room* room) {
+	if (raw) {
+		uint8_t header[ROOM_HEADER] = { ROOM(room_flags, room->wall_count, room->tom[0], room->tom[1], room->jerry[0], room->jerry[1]) };
+		for (int i = 0; i < ROOM_HEADER; i++) emit(header[i]);
+		for (int i = 0; i < room->wall_count; i++) {
+			for (int j = 0; j < 4; j++) emit((uint8_t)(int8_t)room->walls[i][j]);
+		}
+		return;
+	}
+	printf("\tROOM(%s, %d, %d, %d, %d, %d),\n", flag_names(room_flags), room->wall_count,
+		room->tom[0], room->tom[1], room->jerry[0], room->jerry[1]);
+	for (int i = 0; i < room->wall_count; i++) {
+		int* w = room->walls[i];
+		printf("%sROOM_WALL(%d, %d, %d, %d),", (i % 4) ? " " : "\t", w[0], w[1], w[2], w[3]);
+		if (i % 4 == 3 || i == room->wall_count - 1) printf("\n");
+	}
+	pack_bytes += ROOM_HEADER + room->wall_count * 4;
+}
+
+// Returns 0 if the room can't go in a pack
+int compile_room(Room* room, int index) {
+	// The pack has no "keep the last position", unlike a room sent over USB
+	if (!room->has_tom || !room->has_jerry) {
+		fprintf(stderr, "room %d: needs both a T and a J record\n", index);
+		return 0;
+	}
+
+	memset(wall_mask, 0, sizeof(wall_mask));
+	for (int i = 0; i < room->wall_count; i++) raster_wall(room->walls[i], 1);
+
+	if (!raw && index) printf("\n");
+	if (room->name[0]) emit_break(room->name);
+	emit_room(room);
+	if (room_flags & ROOM_HAS_MASK) {
+		emit_break("wall mask");
+		for (int i = 0; i < LCD_BUFFER_SIZE; i++) emit(wall_mask[i]);
+	}
+	emit_break(NULL);
+	return 1;
+}
+
+/*
+**  Read up to n numbers after the record letter, in the game's syntax:
+**  an optional minus, digits and an optional fraction, separated by
+**  spaces, tabs or commas. Returns how many were found, -1 on junk.
+*/
+int read_numbers(const char* s, double* out, int n) {
+	int count = 0;
+	for (;;) {
+		s += strspn(s, " \t,\r\n");
+		if (!*s) return count;
+		size_t len = strcspn(s, " \t,\r\n");
+		char* end;
+		if (count == n || strspn(s, "-.0123456789") < len) return -1;
+		out[count++] = strtod(s, &end);
+		if (end != s + len) return -1;
+		s = end;
+	}
+}
+
+// Check the whole part of a number, as the game does
+int in_range(double v, int lo, int hi) {
+	return (int)v >= lo && (int)v <= hi;
+}
+
+int main(int argc, char* argv[]) {
+	const char* path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-b")) raw = 1;
+		else if (!strcmp(argv[i], "-m")) room_flags |= ROOM_HAS_MASK;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) pack_name = argv[++i];
+		else if (argv[i][0] != '-' && !path) path = argv[i];
+		else {
+			fprintf(stderr, "usage: %s [-b] [-m] [-n name] [rooms.txt]\n", argv[0]);
+			return 2;
+		}
+	}
+	FILE* in = path ? fopen(path, "r") : stdin;
+	if (!in) {
+		perror(path);
+		return 1;
+	}
+
+	if (!raw) {
+		printf("// Generated by roomc from %s, do not edit\n", path ? path : "stdin");
+		printf("const uint8_t %s[] PROGMEM = {\n", pack_name);
+	}
+
+	Room room;
+	memset(&room, 0, sizeof(room));
+	int rooms = 0, errors = 0, line_no = 0;
+	int records = 0; // good records in the room so far
+	char line[MAX_LINE];
+	while (fgets(line, sizeof(line), in)) {
+		line_no++;
+		char* s = line;
+		while (*s == ' ' || *s == '\t') s++;
+		if (*s == '#') {
+			if (!records) { // names the next room
+				s += 1 + strspn(s + 1, " \t");
+				snprintf(room.name, sizeof(room.name), "%.*s", (int)strcspn(s, "\r\n"), s);
+			}
+			continue;
+		}
+		if (*s == '\n' || *s == '\r' || !*s) continue;
+
+		double v[4];
+		int n = read_numbers(s + 1, v, 4);
+		int ok = 0;
+		switch (*s) {
+		case 'T':
+		case 'J':
+			ok = n == 2 && in_range(v[0], 0, LCD_X - MAX_CHAR_WIDTH) && in_range(v[1], GAME_CEILING, LCD_Y - MAX_CHAR_HEIGHT);
+			if (ok) {
+				int* pos = (*s == 'T') ? room.tom : room.jerry;
+				pos[0] = (int)v[0]; // the pack holds whole pixels
+				pos[1] = (int)v[1];
+				*((*s == 'T') ? &room.has_tom : &room.has_jerry) = 1;
+			}
+			break;
+		case 'W':
+			// The game's range, cut to the signed bytes the pack holds
+			ok = n == 4 && room.wall_count < MAX_WALLS && in_range(v[0], -LCD_X, 127) && in_range(v[2], -LCD_X, 127)
+				&& in_range(v[1], -LCD_Y, 2 * LCD_Y) && in_range(v[3], -LCD_Y, 2 * LCD_Y);
+			for (int i = 0; ok && i < 4; i++) room.walls[room.wall_count][i] = (int)v[i];
+			if (ok) room.wall_count++;
+			break;
+		case 'E':
+			ok = n == 0;
+			if (ok) {
+				if (!compile_room(&room, rooms++)) errors++;
+				memset(&room, 0, sizeof(room));
+				records = 0;
+			}
+			break;
+		}
+		if (!ok) {
+			fprintf(stderr, "%s:%d: bad record: %s", path ? path : "stdin", line_no, s);
+			errors++;
+		} else if (*s != 'E') {
+			records++;
+		}
+	}
+	if (records && !compile_room(&room, rooms++)) errors++; // last room without an E
+
+	if (raw) putchar(0);
+	else printf("\t0\n};\n");
+	pack_bytes++;
+
+	if (in != stdin) fclose(in);
+	fprintf(stderr, "%d rooms, %ld bytes\n", rooms, pack_bytes);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+#  sram.sh - SRAM budget of a tj.c build, from the linked ELF
+#
+#      ./sram.sh tj.elf                  sizes in one build
+#      ./sram.sh tj.elf tj_before.elf    this build against an older one
+#
+#  Prints the size of the big globals (game, tom, jerry, ...) and the
+#  .data + .bss total, which is what the 32U4's 2560 bytes of SRAM hold
+#  before the stack. `make sram` builds tj.elf and runs this, and
+#  `make sram BEFORE=<git ref>` also builds tj.c as it was at that ref.
+#
+#  NM and SIZE default to the AVR binutils. With NM=nm SIZE=size it also
+#  reads a host build, though int and pointers are bigger there.
+
+NM=${NM:-avr-nm}
+SIZE=${SIZE:-avr-size}
+SYMBOLS="game tom jerry screen_buffer wall_mask drawn_walls grid_walls grid_objs room_stage"
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+	echo "usage: $0 new.elf [old.elf]" >&2
+	exit 2
+fi
+
+# symbol size, or - when the build has no such symbol
+symbol_size() {
+	hex=$("$NM" -S "$1" | awk -v name="$2" 'NF == 4 && $4 == name { print $2; exit }')
+	if [ -n "$hex" ]; then echo $((0x$hex)); else echo "-"; fi
+}
+
+# .data + .bss (+ .noinit) in bytes
+ram_total() {
+	"$SIZE" -A "$1" | awk '$1 == ".data" || $1 == ".bss" || $1 == ".noinit" { total += $2 } END { print total + 0 }'
+}
+
+row() {
+	if [ -n "$3" ]; then
+		if [ "$2" = "-" ] || [ "$3" = "-" ]; then change=""; else change=$(($2 - $3)); fi
+		printf "  %-16s %7s %7s %7s\n" "$1" "$3" "$2" "$change"
+	else
+		printf "  %-16s %7s\n" "$1" "$2"
+	fi
+}
+
+NEW=$1
+OLD=$2
+if [ -n "$OLD" ]; then
+	printf "  %-16s %7s %7s %7s\n" "" "before" "after" "change"
+fi
+for sym in $SYMBOLS; do
+	new=$(symbol_size "$NEW" "$sym") || exit 1
+	old=""
+	[ -n "$OLD" ] && old=$(symbol_size "$OLD" "$sym")
+	row "$sym" "$new" "$old"
+done
+new=$(ram_total "$NEW")
+old=""
+[ -n "$OLD" ] && old=$(ram_total "$OLD")
+row ".data + .bss" "$new" "$old"
@@ -0,0 +1,44 @@
+/*
+**  Time blit_bitmap() against per-pixel draw_pixel() drawing for each
+**  sprite. These are host timings: they show the ratio between the two,
+**  not AVR cycles.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+#include <time.h>
+
+#define DRAWS 1000000
+
+void pixel_draw(int x, int y, int w, int h, const uint8_t bitmap[], colour_t colour) {
+	for (int i = 0; i < w; i++) {
+		for (int j = 0; j < h; j++) {
+			if (BIT_VALUE(pgm_read_byte(&bitmap[i]), j)) draw_pixel(x + i, y + j, colour);
+		}
+	}
+}
+
+double seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(void) {
+	static const char* names[] = {"tom", "jerry", "super", "cheese", "trap", "milk", "door", "firework"};
+
+	for (unsigned k = 0; k < NUMELEMS(sprites); k++) {
+		Sprite sprite;
+		memcpy_P(&sprite, &sprites[k], sizeof(sprite));
+		const Sprite* s = &sprite;
+		double start = seconds();
+		for (long n = 0; n < DRAWS; n++) pixel_draw(n % 80, GAME_CEILING + n % 30, s->w, s->h, s->bitmap, FG_COLOUR);
+		double per_pixel = seconds() - start;
+		start = seconds();
+		for (long n = 0; n < DRAWS; n++) blit_bitmap(n % 80, GAME_CEILING + n % 30, s->w, s->h, s->bitmap, FG_COLOUR);
+		double blit = seconds() - start;
+		printf("blit_bench: %-8s %dx%d  draw_pixel %5.1f ns  blit_bitmap %5.1f ns  %4.1fx\n", names[k], s->w, s->h,
+			per_pixel * 1e9 / DRAWS, blit * 1e9 / DRAWS, per_pixel / blit);
+	}
+	return 0;
+}
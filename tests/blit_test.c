@@ -0,0 +1,47 @@
+/*
+**  blit_bitmap() against drawing the same sprite one draw_pixel() at a
+**  time, as the game used to: every sprite, in both colours, at every
+**  position from fully off the top-left to fully off the bottom-right,
+**  over a random background.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+void pixel_draw(int x, int y, int w, int h, const uint8_t bitmap[], colour_t colour) {
+	for (int i = 0; i < w; i++) {
+		for (int j = 0; j < h; j++) {
+			if (BIT_VALUE(pgm_read_byte(&bitmap[i]), j)) draw_pixel(x + i, y + j, colour);
+		}
+	}
+}
+
+int main(void) {
+	static uint8_t background[LCD_BUFFER_SIZE], blitted[LCD_BUFFER_SIZE];
+	long cases = 0, bad = 0;
+
+	srand(1);
+	for (unsigned k = 0; k < NUMELEMS(sprites); k++) {
+		Sprite sprite;
+		memcpy_P(&sprite, &sprites[k], sizeof(sprite));
+		const Sprite* s = &sprite;
+		for (int y = -s->h - 1; y <= LCD_Y + 1; y++) {
+			for (int x = -s->w - 1; x <= LCD_X + 1; x++) {
+				for (colour_t colour = BG_COLOUR; colour <= FG_COLOUR; colour++) {
+					for (int i = 0; i < LCD_BUFFER_SIZE; i++) background[i] = rand();
+					memcpy(screen_buffer, background, LCD_BUFFER_SIZE);
+					blit_bitmap(x, y, s->w, s->h, s->bitmap, colour);
+					memcpy(blitted, screen_buffer, LCD_BUFFER_SIZE);
+					memcpy(screen_buffer, background, LCD_BUFFER_SIZE);
+					pixel_draw(x, y, s->w, s->h, s->bitmap, colour);
+					cases++;
+					if (memcmp(blitted, screen_buffer, LCD_BUFFER_SIZE) != 0) {
+						if (bad++ < 10) fprintf(stderr, "blit_test: sprite %u at %d, %d colour %d differs\n", k, x, y, colour);
+					}
+				}
+			}
+		}
+	}
+	printf("blit_test: %ld draws, %ld mismatches\n", cases, bad);
+	return bad != 0;
+}
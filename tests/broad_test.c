@@ -0,0 +1,84 @@
+/*
+**  The broad phase must find every collision the all-pairs loop finds,
+**  in the same order. Scatters cheese, traps, door, milk and fireworks
+**  at random (half of them close to Jerry or Tom, some off-screen and
+**  between pixels), then compares broad_query() + obj_collided() against
+**  obj_collided() over every live object.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define LAYOUTS 100000
+
+int random_between(int lo, int hi) {
+	return lo + rand() % (hi - lo + 1);
+}
+
+void place(Object* obj, Object* near) {
+	if (rand() & 1) {
+		obj->pos.x = near->pos.x + TO_REAL(random_between(-BROAD_REACH - 2, BROAD_REACH + 2));
+		obj->pos.y = near->pos.y + TO_REAL(random_between(-BROAD_REACH - 2, BROAD_REACH + 2));
+	} else {
+		obj->pos.x = TO_REAL(random_between(-10, LCD_X + 10));
+		obj->pos.y = TO_REAL(random_between(-10, LCD_Y + 10));
+	}
+	obj->pos.x += FLOAT_TO_REAL((rand() % 16) / 16.0); // a fraction of a pixel
+	obj->pos.y += FLOAT_TO_REAL((rand() % 16) / 16.0);
+}
+
+// Ids of live objects from first to last colliding with obj, by brute force
+uint8_t all_pairs(Object* obj, uint8_t first, uint8_t last, uint8_t out[]) {
+	uint8_t n = 0;
+	for (uint8_t id = first; id < last; id++) {
+		if (broad_live(id) && obj_collided(obj, broad_object(id))) out[n++] = id;
+	}
+	return n;
+}
+
+uint8_t broad(uint8_t heads[], Object* obj, uint8_t out[]) {
+	uint8_t near[BROAD_IDS], n = broad_query(heads, obj, near), hits = 0;
+	for (uint8_t k = 0; k < n; k++) {
+		if (broad_live(near[k]) && obj_collided(obj, broad_object(near[k]))) out[hits++] = near[k];
+	}
+	return hits;
+}
+
+int main(void) {
+	long collisions = 0, bad = 0;
+
+	srand(5);
+	for (long layout = 0; layout < LAYOUTS; layout++) {
+		jerry.data.obj.sprite = (rand() & 1) ? SPR_JERRY : SPR_SUPER;
+		tom.data.obj.sprite = SPR_TOM;
+		place(&jerry.data.obj, &jerry.data.obj);
+		place(&tom.data.obj, &tom.data.obj);
+
+		game.cheese_pool.live = rand() & ((1 << MAX_CHEESE) - 1);
+		game.trap_pool.live = rand() & ((1 << MAX_TRAPS) - 1);
+		game.firework_pool.live = ((uint32_t)rand() << 8 ^ rand()) & ((1UL << MAX_FIREWORKS) - 1);
+		game.door_active = rand() & 1;
+		game.milk_active = rand() & 1;
+		for (int i = 0; i < MAX_CHEESE; i++) game.cheese[i].sprite = SPR_CHEESE;
+		for (int i = 0; i < MAX_TRAPS; i++) game.traps[i].sprite = SPR_TRAP;
+		for (int i = 0; i < MAX_FIREWORKS; i++) game.fireworks[i].sprite = SPR_FIREWORK;
+		game.door.sprite = SPR_DOOR;
+		game.milk.sprite = SPR_MILK;
+		for (uint8_t id = 0; id < BROAD_FIREWORK0; id++) place(broad_object(id), &jerry.data.obj);
+		for (uint8_t id = BROAD_FIREWORK0; id < BROAD_IDS; id++) place(broad_object(id), &tom.data.obj);
+		broad_rebuild();
+
+		uint8_t want[BROAD_IDS], got[BROAD_IDS];
+		uint8_t nw = all_pairs(&jerry.data.obj, 0, BROAD_FIREWORK0, want);
+		uint8_t ng = broad(broad_pickups, &jerry.data.obj, got);
+		uint8_t nwf = all_pairs(&tom.data.obj, BROAD_FIREWORK0, BROAD_IDS, want + nw);
+		uint8_t ngf = broad(broad_fireworks, &tom.data.obj, got + ng);
+		collisions += nw + nwf;
+		if (nw != ng || nwf != ngf || memcmp(want, got, nw + nwf) != 0) {
+			if (bad++ < 5) fprintf(stderr, "broad_test: layout %ld: all pairs found %d + %d collisions, broad phase %d + %d\n",
+				layout, nw, nwf, ng, ngf);
+		}
+	}
+	printf("broad_test: %d layouts, %ld collisions, %ld layouts differ from all pairs\n", LAYOUTS, collisions, bad);
+	return bad != 0;
+}
@@ -0,0 +1,57 @@
+/*
+**  collide_bitmaps() against a pixel by pixel reference, for every pair
+**  of sprites at every relative offset where their boxes meet (and one
+**  pixel past), from a few base positions including off-screen and
+**  between pixels.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+// Is pixel (x, y) of the screen set by this object
+int sprite_pixel(Object* obj, int x, int y) {
+	int col = x - REAL_INT(obj->pos.x);
+	int row = y - REAL_INT(obj->pos.y);
+	if (col < 0 || col >= OBJ_W(obj) || row < 0 || row >= OBJ_H(obj)) return 0;
+	return BIT_VALUE(pgm_read_byte(&OBJ_BITMAP(obj)[col]), row);
+}
+
+int reference_collide(Object* a, Object* b) {
+	for (int y = REAL_INT(a->pos.y); y < REAL_INT(a->pos.y) + OBJ_H(a); y++) {
+		for (int x = REAL_INT(a->pos.x); x < REAL_INT(a->pos.x) + OBJ_W(a); x++) {
+			if (sprite_pixel(a, x, y) && sprite_pixel(b, x, y)) return 1;
+		}
+	}
+	return 0;
+}
+
+int main(void) {
+	const real bases[][2] = {
+		{TO_REAL(40), TO_REAL(20)},
+		{TO_REAL(-3), TO_REAL(-2)},
+		{FLOAT_TO_REAL(61.5), FLOAT_TO_REAL(33.75)},
+	};
+	long cases = 0, hits = 0, bad = 0;
+
+	for (unsigned base = 0; base < NUMELEMS(bases); base++) {
+		for (uint8_t i = 0; i < NUMELEMS(sprites); i++) {
+			for (uint8_t j = 0; j < NUMELEMS(sprites); j++) {
+				for (int dy = -pgm_read_byte(&sprites[j].h) - 1; dy <= pgm_read_byte(&sprites[i].h) + 1; dy++) {
+					for (int dx = -pgm_read_byte(&sprites[j].w) - 1; dx <= pgm_read_byte(&sprites[i].w) + 1; dx++) {
+						Object a = {{bases[base][0], bases[base][1]}, i};
+						Object b = {{bases[base][0] + TO_REAL(dx), bases[base][1] + TO_REAL(dy)}, j};
+						int want = reference_collide(&a, &b);
+						int got = collide_bitmaps(&a, &b);
+						cases++;
+						hits += want;
+						if (got != want) {
+							if (bad++ < 10) fprintf(stderr, "collide_test: sprites %d, %d at offset %d, %d: got %d, want %d\n", i, j, dx, dy, got, want);
+						}
+					}
+				}
+			}
+		}
+	}
+	printf("collide_test: %ld cases, %ld collisions, %ld mismatches\n", cases, hits, bad);
+	return bad != 0;
+}
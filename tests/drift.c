@@ -0,0 +1,106 @@
+/*
+**  Fixed point against float: how far Jerry and Tom drift apart when the
+**  same game is played by the FIXED_POINT=1 and FIXED_POINT=0 builds.
+**
+**  This file is built twice (make drift). Run on its own, a build plays
+**  FRAMES frames with the host autopilot (same TJ_SEED, so the same
+**  button and wheel script) and prints one line per frame:
+**
+**      frame jerry_x jerry_y tom_x tom_y
+**
+**  Given the path of the other build, it runs that as well, plays its own
+**  game alongside and reports the largest and mean distance between the
+**  two Jerrys and the two Toms, and the first frame they are more than a
+**  pixel apart. Once a bounce or a catch goes the other way the games
+**  take different paths, so drift after that frame is not a rounding
+**  error any more and is only counted up to it.
+**
+**  Fails if that happens before MIN_FRAMES. With REAL_MUL rounding to
+**  nearest, seeds 1 to 8 first diverge between frames 174 and 449; when
+**  it floored, every seed diverged at frame 103.
+**
+**      ./tests/drift_fixed ./tests/drift_float
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define FRAMES 3000
+#define FRAME_US 20000
+#define MIN_FRAMES 150 // fewest frames the builds must stay within 1 px
+
+typedef struct {
+	float jx, jy, tx, ty;
+} Positions;
+
+void step(Positions* p) {
+	if (game_state == GAMEOVER) reset_game();
+	process();
+	host_advance(FRAME_US);
+	p->jx = REAL_FLOAT(jerry.data.obj.pos.x);
+	p->jy = REAL_FLOAT(jerry.data.obj.pos.y);
+	p->tx = REAL_FLOAT(tom.data.obj.pos.x);
+	p->ty = REAL_FLOAT(tom.data.obj.pos.y);
+}
+
+float distance(float x1, float y1, float x2, float y2) {
+	return sqrtf((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+}
+
+int main(int argc, char* argv[]) {
+	setup();
+	reset_game();
+
+	if (argc < 2) {
+		for (int frame = 0; frame < FRAMES; frame++) {
+			Positions p;
+			step(&p);
+			printf("%d %.4f %.4f %.4f %.4f\n", frame, p.jx, p.jy, p.tx, p.ty);
+		}
+		return 0;
+	}
+
+	FILE* other = popen(argv[1], "r");
+	if (!other) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	float jerry_max = 0, tom_max = 0;
+	double jerry_sum = 0, tom_sum = 0;
+	int split = -1, frames = 0;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		Positions p, q;
+		int f;
+		if (fscanf(other, "%d %f %f %f %f", &f, &q.jx, &q.jy, &q.tx, &q.ty) != 5 || f != frame) {
+			fprintf(stderr, "drift: %s stopped at frame %d\n", argv[1], frame);
+			pclose(other);
+			return 1;
+		}
+		step(&p);
+
+		float dj = distance(p.jx, p.jy, q.jx, q.jy);
+		float dt = distance(p.tx, p.ty, q.tx, q.ty);
+		if (dj > 1 || dt > 1) {
+			split = frame;
+			break;
+		}
+		if (dj > jerry_max) jerry_max = dj;
+		if (dt > tom_max) tom_max = dt;
+		jerry_sum += dj;
+		tom_sum += dt;
+		frames++;
+	}
+	pclose(other);
+
+	printf("drift: FIXED_POINT=%d against %s, %d frames compared\n", FIXED_POINT, argv[1], frames);
+	printf("drift: Jerry max %.3f px, mean %.3f px\n", jerry_max, frames ? jerry_sum / frames : 0);
+	printf("drift: Tom   max %.3f px, mean %.3f px\n", tom_max, frames ? tom_sum / frames : 0);
+	if (split >= 0) printf("drift: more than 1 px apart at frame %d, the games diverge from there\n", split);
+	else printf("drift: within 1 px for all %d frames\n", FRAMES);
+	if (split >= 0 && split < MIN_FRAMES) {
+		fprintf(stderr, "drift: diverged at frame %d, before %d\n", split, MIN_FRAMES);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,93 @@
+/*
+**  update_wall_mask_moved() patches the wall mask and the grid in place
+**  rather than rebuilding them. After every batch of random wall moves,
+**  including off-screen and wrapped lines, the patched mask, grid_walls
+**  and free counts must match a rebuild from scratch.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define ROUNDS 20000
+
+int random_between(int lo, int hi) {
+	return lo + rand() % (hi - lo + 1);
+}
+
+void random_line(int line[]) {
+	line[0] = random_between(-10, LCD_X + 10);
+	line[1] = random_between(1 - GAME_CEILING, LCD_Y + 10);
+	switch (rand() % 3) {
+	case 0: // horizontal
+		line[2] = line[0] + random_between(-20, 20);
+		line[3] = line[1];
+		break;
+	case 1: // vertical
+		line[2] = line[0];
+		line[3] = line[1] + random_between(-20, 20);
+		break;
+	default:
+		line[2] = line[0] + random_between(-20, 20);
+		line[3] = line[1] + random_between(-20, 20);
+		break;
+	}
+}
+
+int main(void) {
+	static uint8_t mask[LCD_BUFFER_SIZE];
+	static uint8_t walls[GRID_ROWS][GRID_COLS];
+	static uint8_t row_free[GRID_ROWS];
+	long moves = 0;
+
+	srand(1);
+	game.wall_live = (1 << MAX_WALLS) - 1;
+	for (int i = 0; i < MAX_WALLS; i++) random_line(game.walls[i].line);
+	memset(grid_objs, 0, sizeof(grid_objs));
+	update_wall_mask();
+
+	for (long round = 0; round < ROUNDS; round++) {
+		int old_lines[MAX_WALLS][4];
+		uint8_t moved[MAX_WALLS];
+
+		// Objects come and go too, so the free counts cover both
+		if (round % 50 == 0) {
+			for (int r = 0; r < GRID_ROWS; r++) {
+				for (int c = 0; c < GRID_COLS; c++) grid_objs[r][c] = rand() % 8 == 0;
+			}
+			grid_recount();
+		}
+
+		for (int i = 0; i < MAX_WALLS; i++) {
+			memcpy(old_lines[i], game.walls[i].line, sizeof(old_lines[i]));
+			moved[i] = rand() % 3 == 0;
+			if (!moved[i]) continue;
+			moves++;
+			if (rand() % 8 == 0) {
+				random_line(game.walls[i].line); // a jump, like a wrap-around
+			} else {
+				int dx = random_between(-1, 1), dy = random_between(-1, 1);
+				for (int j = 0; j < 4; j++) game.walls[i].line[j] += (j & 1) ? dy : dx;
+			}
+		}
+		update_wall_mask_moved(old_lines, moved);
+
+		memcpy(mask, wall_mask, sizeof(mask));
+		memcpy(walls, grid_walls, sizeof(walls));
+		memcpy(row_free, grid_row_free, sizeof(row_free));
+		int free = grid_free;
+		update_wall_mask();
+
+		if (memcmp(mask, wall_mask, sizeof(mask)) != 0) {
+			fprintf(stderr, "grid_test: round %ld: wall mask differs from a rebuild\n", round);
+			return 1;
+		}
+		if (memcmp(walls, grid_walls, sizeof(walls)) != 0 ||
+			memcmp(row_free, grid_row_free, sizeof(row_free)) != 0 || free != grid_free) {
+			fprintf(stderr, "grid_test: round %ld: grid differs from a rebuild (%d free, rebuild %d)\n",
+				round, free, grid_free);
+			return 1;
+		}
+	}
+	printf("grid_test: %d rounds, %ld wall moves, grid matched a rebuild after every one\n", ROUNDS, moves);
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+**  AVR cycle counts of getting the screen to the LCD: the library's
+**  byte at a time lcd_write() against lcd_stream() and show_dirty().
+**  Built for the board (make lcd_bench.elf) and run under simavr:
+**
+**      simavr -m atmega32u4 -f 8000000 lcd_bench.elf
+**
+**  A full screen takes more than 65536 cycles, so timer 1 counts every
+**  8 cycles here. Results are printed on USART1, which simavr echoes to
+**  the console, and simavr exits at the end.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+#include <avr/sleep.h>
+
+#define BAUD_9600 51 // UBRR1 at 8 MHz
+#define RUNS 8
+
+#define TIME(total, call) do { \
+	TCNT1 = 0; \
+	call; \
+	total += (uint32_t)TCNT1 * 8; \
+} while (0)
+
+int uart_putchar(char c, FILE* stream) {
+	(void)stream;
+	loop_until_bit_is_set(UCSR1A, UDRE1);
+	UDR1 = c;
+	return 0;
+}
+
+FILE uart = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
+
+void report(const char* name, uint32_t total, uint16_t bytes) {
+	uint32_t cycles = total / RUNS;
+	fprintf(&uart, "%-28s %7lu cycles %5lu us %4lu cycles/byte\r\n", name,
+		(unsigned long)cycles, (unsigned long)(cycles / 8), (unsigned long)(bytes ? cycles / bytes : 0));
+}
+
+// What show_screen() does: position, then lcd_write() per byte
+void write_screen(void) {
+	LCD_CMD(lcd_set_x_addr, 0);
+	LCD_CMD(lcd_set_y_addr, 0);
+	for (int i = 0; i < LCD_BUFFER_SIZE; i++) LCD_DATA(screen_buffer[i]);
+}
+
+// The same bytes through lcd_stream(), one run per bank
+void stream_screen(void) {
+	for (int bank = 0; bank < LCD_BANKS; bank++) {
+		LCD_CMD(lcd_set_x_addr, 0);
+		LCD_CMD(lcd_set_y_addr, bank);
+		lcd_stream(&screen_buffer[bank * LCD_X], LCD_X);
+	}
+}
+
+// A typical frame: Tom and Jerry moved, so two small boxes and where they were
+void dirty_frame(void) {
+	dirty_mark(40, 20, MAX_CHAR_WIDTH + 1, MAX_CHAR_HEIGHT + 1);
+	dirty_mark(10, 33, MAX_CHAR_WIDTH + 1, MAX_CHAR_HEIGHT + 1);
+}
+
+int main(void) {
+	UBRR1 = BAUD_9600;
+	UCSR1B = 1 << TXEN1;
+	set_clock_speed(CPU_8MHz);
+	lcd_init(LCD_DEFAULT_CONTRAST);
+	for (int i = 0; i < LCD_BUFFER_SIZE; i++) screen_buffer[i] = i * 37;
+	TCCR1A = 0;
+	TCCR1B = 1 << CS11; // clk / 8
+
+	uint32_t t_write = 0, t_stream = 0, t_show = 0, t_dirty_all = 0, t_dirty_frame = 0;
+	for (uint8_t run = 0; run < RUNS; run++) {
+		TIME(t_write, write_screen());
+		TIME(t_stream, stream_screen());
+		TIME(t_show, show_screen());
+
+		dirty_mark_all();
+		show_dirty(); // clear the previous frame's spans
+		dirty_mark_all();
+		TIME(t_dirty_all, show_dirty());
+
+		dirty_frame();
+		show_dirty();
+		dirty_frame();
+		TIME(t_dirty_frame, show_dirty());
+	}
+
+	fprintf(&uart, "lcd_bench: average per screen\r\n");
+	report("lcd_write x 504", t_write, LCD_BUFFER_SIZE);
+	report("show_screen (library)", t_show, LCD_BUFFER_SIZE);
+	report("lcd_stream, 6 banks", t_stream, LCD_BUFFER_SIZE);
+	report("show_dirty, all dirty", t_dirty_all, LCD_BUFFER_SIZE);
+	report("show_dirty, two sprites", t_dirty_frame, 0);
+
+	cli();
+	sleep_mode(); // simavr stops on sleep with interrupts off
+	for (;;) {}
+}
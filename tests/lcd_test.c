@@ -0,0 +1,33 @@
+/*
+**  After every frame the LCD must show exactly what is in screen_buffer:
+**  show_dirty() only sends the columns it thinks changed, so a missed
+**  dirty_mark() leaves stale pixels on the display. Plays the game with
+**  the host autopilot and compares the fake LCD's RAM after each frame.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define FRAMES 20000
+#define FRAME_US 20000
+
+int main(void) {
+	setup();
+	reset_game();
+
+	for (long frame = 0; frame < FRAMES; frame++) {
+		if (game_state == GAMEOVER) reset_game();
+		process();
+		if (memcmp(lcd_ram, screen_buffer, LCD_BUFFER_SIZE) != 0) {
+			int i = 0;
+			while (lcd_ram[i] == screen_buffer[i]) i++;
+			fprintf(stderr, "lcd_test: frame %ld: LCD differs from screen_buffer at bank %d column %d\n",
+				frame, i / LCD_X, i % LCD_X);
+			host_dump_lcd(stderr);
+			return 1;
+		}
+		host_advance(FRAME_US);
+	}
+	printf("lcd_test: %d frames, LCD matched screen_buffer after every one\n", FRAMES);
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+**  Level pack rooms are chosen, not walked through: level 1 plays pack
+**  room 0 and its door leads straight to level 2, as before the pack.
+**  At level 2 an "R n" record plays pack room n. Every room carries the
+**  wall mask roomc rasterised, and it is the one the game would draw.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+int failures;
+
+// Are the live walls exactly the ones of pack room n
+int walls_match(uint8_t n) {
+	const uint8_t* room = room_find(level_pack, n);
+	uint8_t walls = pgm_read_byte(room + 2);
+	for (uint8_t i = 0; i < MAX_WALLS; i++) {
+		if (WALL_LIVE(i) != (i < walls)) return 0;
+		for (uint8_t j = 0; i < walls && j < 4; j++) {
+			if (game.walls[i].line[j] != (int8_t)pgm_read_byte(room + ROOM_HEADER + i * 4 + j)) return 0;
+		}
+	}
+	return 1;
+}
+
+// Is pack room n's precomputed mask the one update_wall_mask() draws
+int mask_matches(uint8_t n) {
+	const uint8_t* room = room_find(level_pack, n);
+	if (!(pgm_read_byte(room + 1) & ROOM_HAS_MASK)) return 0;
+	room_unpack(n);
+	uint8_t packed[LCD_BUFFER_SIZE];
+	uint8_t packed_grid[GRID_ROWS][GRID_COLS];
+	memcpy(packed, wall_mask, sizeof(packed));
+	memcpy(packed_grid, grid_walls, sizeof(packed_grid));
+	update_wall_mask();
+	return memcmp(packed, wall_mask, sizeof(packed)) == 0 && memcmp(packed_grid, grid_walls, sizeof(packed_grid)) == 0;
+}
+
+void check(int ok, const char* what) {
+	if (ok) return;
+	fprintf(stderr, "pack_test: %s\n", what);
+	failures++;
+}
+
+void send(const char* text) {
+	while (*text) room_parse(*text++);
+}
+
+int main(void) {
+	setup();
+	uint8_t rooms = 0;
+	for (; room_find(level_pack, rooms); rooms++) {
+		char what[48];
+		snprintf(what, sizeof(what), "pack room %d has no mask or the wrong one", rooms);
+		check(mask_matches(rooms), what);
+	}
+
+	reset_game();
+	check(game.level == 1 && walls_match(0), "level 1 does not start in pack room 0");
+
+	// Jerry walks into the door
+	game.door.sprite = SPR_DOOR;
+	game.door.pos = jerry.data.obj.pos;
+	game.door_active = 1;
+	do_collisions();
+	check(game.level == 2 && game_state == RUNNING, "the level 1 door does not lead to level 2");
+	check(room_state == ROOM_CONNECT, "level 2 is not waiting for a room");
+
+	room_state = ROOM_RECORD; // the link is up
+	send("R 3\n");
+	check(walls_match(3) && room_state == ROOM_IDLE, "\"R 3\" did not play pack room 3");
+	check(room_errors == 0, "\"R 3\" was rejected");
+
+	load_room();
+	room_state = ROOM_RECORD;
+	send("R 200\n");
+	check(walls_match(3) && room_errors == 1, "\"R 200\" past the end of the pack was not rejected");
+
+	if (failures) return 1;
+	printf("pack_test: %d rooms with matching masks, level 1 door leads to level 2, \"R n\" plays pack rooms\n", rooms);
+	return 0;
+}
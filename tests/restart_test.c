@@ -0,0 +1,66 @@
+/*
+**  Restarting mid-frame (left button at level 2 -> GAMEOVER ->
+**  reset_game) restarts the clock and the event wheel. The rest of that
+**  frame must run against the new clock, or every event is rescheduled
+**  from the old game's time and spawning stalls for as long as the old
+**  game lasted. Plays a long game, restarts, and checks cheese is back
+**  on the old schedule.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define LONG_GAME 3000 // frames, about a minute
+#define FRAME_US 20000
+
+// A left button press, as the input ISR queues it
+void press_left(void) {
+	input_push(IN_B_LEFT, 1);
+	input_push(IN_B_LEFT, 0);
+	process();
+	host_advance(FRAME_US);
+}
+
+int main(void) {
+	setup();
+	reset_game();
+
+	for (int frame = 0; frame < LONG_GAME; frame++) {
+		if (game_state == GAMEOVER) reset_game();
+		process();
+		host_advance(FRAME_US);
+	}
+	uint32_t old_ms = now_ms;
+
+	if (game.level == 2) press_left(); // to level 1 first: the restart is from level 2
+	press_left(); // level 1 -> 2
+	press_left(); // level 2 -> GAMEOVER -> restart
+	if (game.level != 1 || game_state != RUNNING) {
+		fprintf(stderr, "restart_test: left button did not restart the game\n");
+		return 1;
+	}
+	uint32_t clock = clock_millis();
+	for (int ev = EV_CHEESE; ev <= EV_MILK; ev++) {
+		if (wheel_slot[ev] == WHEEL_NONE || wheel_deadline[ev] > clock + MILK_MS) {
+			fprintf(stderr, "restart_test: event %d due at %lu ms, clock at %lu ms after a %lu ms game\n",
+				ev, (unsigned long)wheel_deadline[ev], (unsigned long)clock, (unsigned long)old_ms);
+			return 1;
+		}
+	}
+
+	// First cheese is due at CHEESE_MS; allow a few frames over
+	uint32_t cheese_ms = 0;
+	while (now_ms < CHEESE_MS + 500 && !cheese_ms) {
+		process();
+		host_advance(FRAME_US);
+		if (game.cheese_pool.live) cheese_ms = now_ms;
+	}
+	if (!cheese_ms) {
+		fprintf(stderr, "restart_test: no cheese %d ms after restarting from a %lu ms game\n",
+			CHEESE_MS + 500, (unsigned long)old_ms);
+		return 1;
+	}
+	printf("restart_test: restarted after a %lu ms game, first cheese at %lu ms\n",
+		(unsigned long)old_ms, (unsigned long)cheese_ms);
+	return 0;
+}
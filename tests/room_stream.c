@@ -0,0 +1,77 @@
+/*
+**  Streams rooms to the level 2 loader over the fake USB link (64 bytes
+**  per ms, like a full speed CDC port) and reports how many rooms a
+**  second it takes in at ROOM_BYTES_PER_FRAME. Then drops back to level
+**  1 halfway through a room and checks the loader stays cancelled:
+**  nothing more is read and the level 1 room is left alone.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define ROOMS 500
+#define ROOMS_TIMED 400 // the rest are left for the cancel check
+#define FRAME_US 30000
+
+const char room_text[] = "T 70.5 30\nJ 3 12.25\nW 10 15 10 40\nW 20 20 60 20\nW 45 10 60 10\nW 58 25 72 30\nE\n";
+
+int main(void) {
+	char path[] = "/tmp/room_streamXXXXXX";
+	int fd = mkstemp(path);
+	FILE* out = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (!out) {
+		perror("room_stream");
+		return 1;
+	}
+	for (int i = 0; i < ROOMS; i++) fputs(room_text, out);
+	fclose(out);
+	setenv("TJ_USB_IN", path, 1);
+
+	setup();
+	reset_game();
+	game.level = 2;
+	load_room();
+
+	int rooms = 0;
+	long frames = 0;
+	while (rooms < ROOMS_TIMED) {
+		host_advance(FRAME_US);
+		now_ms = clock_millis();
+		room_poll();
+		frames++;
+		if (room_state == ROOM_IDLE) {
+			rooms++;
+			load_room();
+		}
+	}
+	remove(path);
+
+	int ok = room_errors == 0 && game.wall_live == 0x0F && game.walls[1].line[2] == 60
+		&& tom.data.origin.x == FLOAT_TO_REAL(70.5) && jerry.data.origin.y == FLOAT_TO_REAL(12.25);
+	double seconds = frames * (FRAME_US / 1e6);
+	printf("room_stream: %d rooms of %d bytes in %ld frames of %d ms = %.1f rooms/s (%d B/frame budget)%s\n",
+		rooms, (int)strlen(room_text), frames, FRAME_US / 1000, rooms / seconds, ROOM_BYTES_PER_FRAME,
+		ok ? "" : ", WRONG ROOM");
+
+	// Half a room in, the game drops back to level 1
+	host_advance(FRAME_US);
+	now_ms = clock_millis();
+	room_poll();
+	game_state = GAMEOVER;
+	game.level = 1;
+	reset_game();
+	int walls[MAX_WALLS][4];
+	for (int i = 0; i < MAX_WALLS; i++) memcpy(walls[i], game.walls[i].line, sizeof(walls[i]));
+	uint8_t live = game.wall_live;
+	uint8_t waiting = usb_serial_available();
+	for (int i = 0; i < 100; i++) {
+		host_advance(FRAME_US);
+		now_ms = clock_millis();
+		room_poll();
+	}
+	int kept = room_state == ROOM_IDLE && game.wall_live == live && usb_serial_available() >= waiting;
+	for (int i = 0; kept && i < MAX_WALLS; i++) kept = memcmp(walls[i], game.walls[i].line, sizeof(walls[i])) == 0;
+	printf("room_stream: loader %s after dropping to level 1\n", kept ? "cancelled" : "STILL RUNNING");
+
+	return ok && kept ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+/*
+**  roomc against the game's own rules: T and J in the range
+**  room_end_record() accepts, fractions taken, bad records after the last
+**  E not turned into an extra room, and level_pack.h up to date with
+**  rooms.txt. Runs ./roomc, so `make test` builds it first.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_PACK 1024
+
+int failures;
+
+// Compile text with roomc -b, returns its exit status and the pack bytes
+int compile(const char* text, uint8_t* pack, int* bytes) {
+	char path[] = "/tmp/roomc_testXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0 || write(fd, text, strlen(text)) != (ssize_t)strlen(text)) {
+		perror("roomc_test");
+		exit(1);
+	}
+	close(fd);
+
+	char command[128];
+	snprintf(command, sizeof(command), "./roomc -b %s 2>/dev/null", path);
+	FILE* out = popen(command, "r");
+	*bytes = fread(pack, 1, MAX_PACK, out);
+	int status = pclose(out);
+	unlink(path);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void expect(const char* name, const char* text, int status, const uint8_t* want, int want_bytes) {
+	uint8_t pack[MAX_PACK];
+	int bytes;
+	int got = compile(text, pack, &bytes);
+	if (got != status || bytes != want_bytes || memcmp(pack, want, bytes) != 0) {
+		fprintf(stderr, "roomc_test: %s: exit %d, %d bytes (want exit %d, %d bytes)\n", name, got, bytes, status, want_bytes);
+		failures++;
+	}
+}
+
+int main(void) {
+	const uint8_t fraction[] = { 1, 0, 1, 10, 20, 0, 10, 1, 2, 3, 4, 0 };
+	expect("fractional T", "T 10.5 20\nJ 0 10\nW 1 2 3 4\nE\n", 0, fraction, sizeof(fraction));
+	expect("bad record after E", "T 10.5 20\nJ 0 10\nW 1 2 3 4\nE\nW 1 2\n", 1, fraction, sizeof(fraction));
+
+	// Largest positions the game takes, then one past each
+	const uint8_t corner[] = { 1, 0, 0, 79, 41, 0, 10, 0 };
+	expect("T at the limits", "T 79 41.9\nJ -0.5 10\nE\n", 0, corner, sizeof(corner));
+	expect("T past x", "T 80 20\nJ 0 10\nE\n", 1, (const uint8_t*)"\0", 1);
+	expect("J past y", "T 10 20\nJ 0 42\nE\n", 1, (const uint8_t*)"\0", 1);
+	expect("J above the ceiling", "T 10 20\nJ 0 9\nE\n", 1, (const uint8_t*)"\0", 1);
+	expect("no J", "T 10 20\nE\n", 1, (const uint8_t*)"\0", 1);
+
+	if (system("./roomc -m -n level_pack rooms.txt 2>/dev/null | cmp -s - level_pack.h") != 0) {
+		fprintf(stderr, "roomc_test: level_pack.h is out of date with rooms.txt, run make level_pack.h\n");
+		failures++;
+	}
+
+	if (failures) return 1;
+	printf("roomc_test: range checks, fractions and trailing records match the game, level_pack.h is current\n");
+	return 0;
+}
@@ -0,0 +1,63 @@
+/*
+**  find_clear() must take bounded work however crowded the room. Fills
+**  random wall layouts with door-sized objects (2x2 grid cells) until
+**  nothing fits, then keeps trying, and checks the worst call against
+**  the bound: the rows and cells stepped to find the k-th free cell plus
+**  one footprint tried per playable cell.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define LAYOUTS 2000
+#define MAX_OBJECTS 64
+#define PLAYABLE_CELLS ((GRID_ROWS - GRID_TOP) * GRID_COLS)
+#define STEP_BOUND ((GRID_ROWS - GRID_TOP) + GRID_COLS + PLAYABLE_CELLS)
+
+void random_walls(void) {
+	game.wall_live = 0;
+	for (int i = 0; i < MAX_WALLS; i++) {
+		int* line = game.walls[i].line;
+		line[0] = rand() % LCD_X;
+		line[1] = GAME_CEILING + rand() % (LCD_Y - GAME_CEILING);
+		line[2] = (rand() & 1) ? line[0] : rand() % LCD_X; // vertical or slanted
+		line[3] = GAME_CEILING + rand() % (LCD_Y - GAME_CEILING);
+		game.wall_live |= 1 << i;
+	}
+	update_wall_mask();
+}
+
+int main(void) {
+	static Object objects[MAX_OBJECTS];
+	long calls = 0, placed = 0, full = 0;
+
+	setup();
+	reset_game();
+	srand(7);
+	for (int layout = 0; layout < LAYOUTS; layout++) {
+		random_walls();
+		grid_reset_objects();
+		int n = 0, misses = 0;
+		while (misses < 4) { // a few calls on a full room: the worst case
+			Object* obj = &objects[n < MAX_OBJECTS ? n : MAX_OBJECTS - 1];
+			obj->sprite = SPR_DOOR;
+			calls++;
+			if (find_clear(obj) && n < MAX_OBJECTS) {
+				grid_mark_object(obj, 1);
+				n++;
+				placed++;
+			} else {
+				misses++;
+				full++;
+			}
+		}
+	}
+
+	printf("spawn_test: %ld find_clear calls over %d layouts (%ld placed, %ld with no room), worst %u steps (bound %d)\n",
+		calls, LAYOUTS, placed, full, spawn_steps_max, STEP_BOUND);
+	if (spawn_steps_max > STEP_BOUND) {
+		fprintf(stderr, "spawn_test: find_clear took %u steps, over the bound of %d\n", spawn_steps_max, STEP_BOUND);
+		return 1;
+	}
+	return 0;
+}
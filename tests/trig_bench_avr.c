@@ -0,0 +1,95 @@
+/*
+**  AVR cycle counts of the lookup-table trig against avr-libm. Built for
+**  the board (make trig_bench.elf) and run under simavr:
+**
+**      simavr -m atmega32u4 -f 8000000 trig_bench.elf
+**
+**  Timer 1 runs at the CPU clock and each call is timed on its own, less
+**  the cost of an empty measurement. Results are printed on USART1,
+**  which simavr echoes to the console, and simavr exits at the end.
+**
+**  No results have been recorded yet: it has not been run under simavr.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+#include <avr/sleep.h>
+
+#define BAUD_9600 51 // UBRR1 at 8 MHz
+
+volatile real sink_real;
+volatile angle_t sink_angle;
+volatile float sink_float;
+
+#define TIME(total, call) do { \
+	TCNT1 = 0; \
+	call; \
+	total += TCNT1; \
+} while (0)
+
+int uart_putchar(char c, FILE* stream) {
+	(void)stream;
+	loop_until_bit_is_set(UCSR1A, UDRE1);
+	UDR1 = c;
+	return 0;
+}
+
+FILE uart = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
+
+uint32_t report(const char* name, uint32_t total, uint16_t count, uint16_t overhead) {
+	uint32_t cycles = total / count - overhead;
+	fprintf(&uart, "%-16s %6lu cycles\r\n", name, (unsigned long)cycles);
+	return cycles;
+}
+
+void speedup(const char* name, uint32_t ours, uint32_t libm) {
+	fprintf(&uart, "%-16s %3lu.%lux faster than libm\r\n", name,
+		(unsigned long)(libm / ours), (unsigned long)(libm * 10 / ours % 10));
+}
+
+int main(void) {
+	UBRR1 = BAUD_9600;
+	UCSR1B = 1 << TXEN1;
+	TCCR1A = 0;
+	TCCR1B = 1 << CS10; // no prescale: one count per cycle
+
+	uint32_t overhead = 0;
+	for (uint16_t i = 0; i < 256; i++) TIME(overhead, (void)0);
+	overhead /= 256;
+
+	uint32_t t_sin = 0, t_cos = 0, t_libm_sin = 0, t_libm_cos = 0;
+	for (uint16_t a = 0; a < 256; a++) {
+		float radians = a * (float)M_PI / 128;
+		TIME(t_sin, sink_real = sin_real(a));
+		TIME(t_cos, sink_real = cos_real(a));
+		TIME(t_libm_sin, sink_float = sin(radians));
+		TIME(t_libm_cos, sink_float = cos(radians));
+	}
+
+	// Screen sized Q8.8 differences, as get_direction() passes them
+	uint32_t t_atan = 0, t_libm_atan = 0;
+	uint16_t count = 0;
+	for (int16_t y = -LCD_Y * 256; y <= LCD_Y * 256; y += 1531) {
+		for (int16_t x = -LCD_X * 128; x <= LCD_X * 128; x += 1379) {
+			float fy = y, fx = x;
+			TIME(t_atan, sink_angle = angle_atan2(y, x));
+			TIME(t_libm_atan, sink_float = atan2(fy, fx));
+			count++;
+		}
+	}
+
+	fprintf(&uart, "trig_bench: average per call\r\n");
+	uint32_t sin_cycles = report("sin_real", t_sin, 256, overhead);
+	uint32_t libm_sin_cycles = report("libm sin", t_libm_sin, 256, overhead);
+	uint32_t cos_cycles = report("cos_real", t_cos, 256, overhead);
+	uint32_t libm_cos_cycles = report("libm cos", t_libm_cos, 256, overhead);
+	uint32_t atan_cycles = report("angle_atan2", t_atan, count, overhead);
+	uint32_t libm_atan_cycles = report("libm atan2", t_libm_atan, count, overhead);
+	speedup("sin_real", sin_cycles ? sin_cycles : 1, libm_sin_cycles);
+	speedup("cos_real", cos_cycles ? cos_cycles : 1, libm_cos_cycles);
+	speedup("angle_atan2", atan_cycles ? atan_cycles : 1, libm_atan_cycles);
+
+	cli();
+	sleep_mode(); // simavr stops on sleep with interrupts off
+	for (;;) {}
+}
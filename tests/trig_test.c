@@ -0,0 +1,39 @@
+/*
+**  The lookup-table trig against libm: sin_real/cos_real over the whole
+**  binary circle, and angle_atan2 over Q8.8 differences the size of the
+**  screen, which is what get_direction() gives it.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define SIN_TOLERANCE 0.004 // one Q8.8 step
+#define ATAN_TOLERANCE 1.5 // binary angle units (256 per turn)
+
+int main(void) {
+	double sin_error = 0, atan_error = 0;
+	long cases = 0;
+
+	for (int a = 0; a < 256; a++) {
+		double e = fabs(REAL_FLOAT(sin_real(a)) - sin(a * M_PI / 128));
+		if (e > sin_error) sin_error = e;
+		e = fabs(REAL_FLOAT(cos_real(a)) - cos(a * M_PI / 128));
+		if (e > sin_error) sin_error = e;
+	}
+
+	for (int32_t y = -LCD_X * 256; y <= LCD_X * 256; y += 37) {
+		for (int32_t x = -LCD_X * 256; x <= LCD_X * 256; x += 41) {
+			if (x == 0 && y == 0) continue;
+			double want = atan2(y, x) * 128 / M_PI;
+			double e = fmod(angle_atan2(y, x) - want + 512.0, 256.0);
+			if (e > 128) e = 256 - e;
+			if (e > atan_error) atan_error = e;
+			cases++;
+		}
+	}
+
+	int ok = sin_error <= SIN_TOLERANCE && atan_error <= ATAN_TOLERANCE;
+	printf("trig_test: max sin/cos error %.4f (limit %.4f), max atan2 error %.2f units = %.2f degrees over %ld cases (limit %.1f)\n",
+		sin_error, SIN_TOLERANCE, atan_error, atan_error * 360 / 256, cases, ATAN_TOLERANCE);
+	return !ok;
+}
@@ -0,0 +1,87 @@
+/*
+**  wall_sides() and collide_bitmap_wall() read the wall mask a byte at a
+**  time. Checks them against check_wall() pixel by pixel, for random
+**  wall layouts (lines running off every edge, as wrapping walls do) and
+**  boxes everywhere on and around the screen, across bank boundaries
+**  and the top and bottom rows.
+*/
+#define main tj_main
+#include "../tj.c"
+#undef main
+
+#define LAYOUTS 500
+#define BOXES 2000
+
+int random_between(int lo, int hi) {
+	return lo + rand() % (hi - lo + 1);
+}
+
+// The per-pixel edge scan wall_sides() replaced
+uint8_t reference_sides(int x, int y, int w, int h) {
+	uint8_t sides = 0;
+	for (int i = y; i < y + h; i++) {
+		if (check_wall(x, i)) sides |= WALL_LEFT;
+		if (check_wall(x + w - 1, i)) sides |= WALL_RIGHT;
+	}
+	for (int i = x; i < x + w; i++) {
+		if (check_wall(i, y)) sides |= WALL_TOP;
+		if (check_wall(i, y + h - 1)) sides |= WALL_BOTTOM;
+	}
+	return sides;
+}
+
+// collide_bitmap_wall() as it was, one check_wall() per pixel
+int reference_collide(int x1, int y1, int x2, int y2, collide_dir dir) {
+	if (dir == BT) {
+		for (int i = y1; i < y2; i++) if (check_wall(x1, i)) return 1;
+	} else {
+		for (int i = x1; i < x2; i++) if (check_wall(i, y1)) return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	long cases = 0, hits = 0, bad = 0;
+
+	srand(3);
+	for (int layout = 0; layout < LAYOUTS; layout++) {
+		game.wall_live = (1 << MAX_WALLS) - 1;
+		for (int i = 0; i < MAX_WALLS; i++) {
+			int* line = game.walls[i].line;
+			line[0] = random_between(-20, LCD_X + 20);
+			line[1] = random_between(1 - GAME_CEILING, LCD_Y + 10);
+			line[2] = (rand() % 3 == 0) ? line[0] : random_between(-20, LCD_X + 20);
+			line[3] = (rand() % 3 == 0) ? line[1] : random_between(1 - GAME_CEILING, LCD_Y + 10);
+		}
+		update_wall_mask();
+
+		for (int n = 0; n < BOXES; n++) {
+			int x = random_between(-10, LCD_X + 2);
+			int y = (n & 1) ? 8 * random_between(-1, LCD_BANKS) + random_between(-2, 1) // near bank edges
+				: random_between(-10, LCD_Y + 2);
+			int w = random_between(1, 8), h = random_between(1, 8);
+
+			uint8_t got = wall_sides(x, y, w, h), want = reference_sides(x, y, w, h);
+			cases++;
+			hits += want != 0;
+			if (got != want) {
+				if (bad++ < 5) fprintf(stderr, "wall_test: wall_sides(%d, %d, %d, %d) = %x, per pixel %x\n", x, y, w, h, got, want);
+			}
+
+			// Edge strips as process_input() asks, including empty ones
+			int len = random_between(0, 9);
+			for (int dir = BT; dir <= LR; dir++) {
+				int x2 = (dir == LR) ? x + len : x;
+				int y2 = (dir == BT) ? y + len : y;
+				int c = collide_bitmap_wall(x, y, x2, y2, dir), r = reference_collide(x, y, x2, y2, dir);
+				cases++;
+				if (c != r) {
+					if (bad++ < 5) fprintf(stderr, "wall_test: collide_bitmap_wall(%d, %d, %d, %d, %s) = %d, per pixel %d\n",
+						x, y, x2, y2, dir == BT ? "BT" : "LR", c, r);
+				}
+			}
+		}
+	}
+	printf("wall_test: %ld cases, %ld boxes touching walls, %ld mismatches\n", cases, hits, bad);
+	return bad != 0;
+}
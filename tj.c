@@ -1,29 +1,54 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef HOST
+#include "host/hal.h" // in-memory board for running on a PC, see host/hal.c
+#else
 #include <avr/io.h> 
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
 #include <util/delay.h>
 #include <cpu_speed.h>
-#include <string.h>
 
 #include <graphics.h>
 #include <macros.h>
 #include "lcd_model.h"
 #include "lcd.h"
 #include "usb_serial.h"
-#include "cab202_adc.h"
 
+#define hal_idle() // the interrupts run by themselves on the board
+#define hal_frame()
+#endif
+
+#include "room.h" // limits, binary room format and wall rasteriser, shared with roomc.c
 
 #define FREQ      (8000000.0)
 #define PRESCALE0 (1.0) //  for a Freq of 7.8125Khz
 #define PRESCALE1 (8.0)    //  for a Freq of 1Mhz
-#define PRESCALE3 (1024.0)  //  for a Freq of 31.25Khz
+#define PRESCALE3 (64.0)  //  for a Freq of 125Khz
+#define TICKS_PER_MS 125 // timer 3 compare value for a 1 ms tick
+
+// Game event periods (ms)
+#define CHEESE_MS 2000
+#define TRAP_MS 3000
+#define MILK_MS 5000
+#define SUPER_MS 10000
+#define SUPER_STEP_MS 1000 // super mode LED countdown step
+
+// Timer wheel: WHEEL_SLOTS buckets of 2^WHEEL_SHIFT ms each
+#define WHEEL_SHIFT 8
+#define WHEEL_SLOTS 8
+#define WHEEL_NONE 0xFF
 #define SQRT(x,y) sqrt(x*x + y*y)
 #define NUMELEMS(x)  (sizeof(x) / sizeof((x)[0]))
 #define MAX(x,y) (x > y) ? x : y
 #define MIN(x,y) (x < y) ? x : y
-#define scale_velocity(x) (x*(duty_cycle_l/100)+0.1);			
+#define ROW_MASK(h) (((h) >= 8) ? 0xFF : (1 << (h)) - 1) // first h rows of a bitmap column
+#define scale_velocity(x) (x*(duty_cycle_l/100)+FLOAT_TO_REAL(0.1));			
 
 #ifndef M_PI
 #define M_PI        3.14159265358979323846264338327950288   /* pi             */
@@ -32,113 +57,217 @@
 #define BACKLIGHT 1 // 1 for on, 0 for off
 
 // Limits
-#define GAME_CEILING 10
-#define MAX_WALLS 6
 #define MAX_CHEESE 5
 #define MAX_TRAPS 5
 #define MAX_FIREWORKS 20
-#define MAX_CHAR_WIDTH 5 // max px width of Tom or Jerry
-#define MAX_CHAR_HEIGHT 7 // max px height of Tom or Jerry
 #define TN_OBJ_WIDTH 1 // tiny object
 #define TN_OBJ_HEIGHT 1
 #define SM_OBJ_WIDTH 3 // small object
 #define SM_OBJ_HEIGHT 3
+#define MILK_WIDTH 6 // milk is wider than the other small objects
 #define MD_OBJ_WIDTH 5 // medium object
 #define MD_OBJ_HEIGHT 5
 #define DEBOUNCE_MASK 0b00000011 // How many consequtive polls to assume input (debounce)
+#define INPUT_QUEUE 16 // input event ring size, power of 2
+#define WALL_TICKS_MAX 4 // most wall steps caught up in one frame
+#define ADC_OVERSAMPLE_SHIFT 4 // 16 conversions averaged per published reading
+#define TELEMETRY_EVERY 1 // frames per telemetry frame at level 2
+#define TELEMETRY_FULL 32 // every n-th telemetry frame carries all fields
+#define TELEMETRY_SYNC 0xA5
+#define TX_RING 128 // USB transmit ring, power of 2
+#define ROOM_BYTES_PER_FRAME 64 // most room bytes parsed per frame (one USB packet)
+#define ROOM_IDLE_MS 250 // a room with no end record is complete after this quiet time
+#define WALL_SPEED_DIV 21 // (duty_cycle_r / 4) per px of wall speed, ~3 px per tick at full
 #define PURSUIT_DELAY   1 // how many ticks to predict
+#define LCD_BANKS (LCD_Y / 8)
+#define BROAD_CELL 16 // px per side of a broad phase cell
+#define BROAD_COLS ((LCD_X + BROAD_CELL - 1) / BROAD_CELL)
+#define BROAD_ROWS ((LCD_Y + BROAD_CELL - 1) / BROAD_CELL)
+#define BROAD_REACH 8 // widest/tallest object kept in the broad phase
+#define BROAD_NONE 0xFF
+// Broad phase ids: cheese, traps, door, milk, then fireworks
+#define BROAD_TRAP0 MAX_CHEESE
+#define BROAD_DOOR (MAX_CHEESE + MAX_TRAPS)
+#define BROAD_MILK (BROAD_DOOR + 1)
+#define BROAD_FIREWORK0 (BROAD_MILK + 1)
+#define BROAD_IDS (BROAD_FIREWORK0 + MAX_FIREWORKS)
 
 typedef enum { BT, LR } collide_dir; // bottom-top, left-right
+#define WALL_LEFT   0x01 // blocked sides from wall_sides()
+#define WALL_RIGHT  0x02
+#define WALL_TOP    0x04
+#define WALL_BOTTOM 0x08
 typedef enum { WELCOME, RUNNING, PAUSE, GAMEOVER } GAME_STATE; 
+typedef enum { EV_CHEESE, EV_TRAP, EV_MILK, EV_SUPER, EV_COUNT } game_event;
+typedef enum { TM_TIME, TM_LEVEL, TM_SCORE, TM_LIVES, TM_FIREWORKS, TM_CHEESE, TM_TRAPS, TM_CHEESE_ROOM,
+	TM_SUPER, TM_PAUSED, TM_SPAWN_MAX, TM_INPUT_MAX, TM_INPUT_LOST, TM_TX_LOST, TM_ROOM_ERRORS, TM_COUNT } telemetry_field;
+typedef enum { ROOM_IDLE, ROOM_CONNECT, ROOM_RECORD, ROOM_FIELDS, ROOM_SKIP } room_step;
+typedef enum { IN_J_UP, IN_J_DOWN, IN_J_LEFT, IN_J_RIGHT, IN_J_CENTER, IN_B_LEFT, IN_B_RIGHT, IN_COUNT } input_id;
 
 // Gameplay variables
 #define JERRY_SPEED 1
 #define TOM_SPEED 0.8
 #define FW_SPEED 2.5
 
+// Physics number type. With FIXED_POINT set positions, velocities and
+// speeds are Q8.8 integers, so the AVR doesn't emulate float every frame.
+#ifndef FIXED_POINT
+#define FIXED_POINT 1
+#endif
+
+#if FIXED_POINT
+typedef int16_t real; // Q8.8, range +-127
+#define FIX_SHIFT 8
+#define TO_REAL(x) ((real)((x) * (1 << FIX_SHIFT)))
+#define FLOAT_TO_REAL(x) ((real)((x) * (1 << FIX_SHIFT) + ((x) < 0 ? -0.5 : 0.5))) // rounded
+#define REAL_INT(x) ((x) >> FIX_SHIFT) // floor
+#define REAL_ROUND(x) (((x) + (1 << (FIX_SHIFT - 1))) >> FIX_SHIFT)
+#define REAL_MUL(a,b) ((real)(((int32_t)(a) * (b) + (1 << (FIX_SHIFT - 1))) >> FIX_SHIFT)) // to nearest
+#define REAL_FLOAT(x) ((x) / (float)(1 << FIX_SHIFT))
+#define REAL_TRUNC(x) ((x) < 0 ? -(-(x) >> FIX_SHIFT) : (x) >> FIX_SHIFT) // toward 0
+#define Q8_TO_REAL(x) ((real)(x)) // from a Q8.8 lookup value
+#define REAL_TO_Q8(x) ((int16_t)(x))
+#else
+typedef float real;
+#define TO_REAL(x) ((real)(x))
+#define FLOAT_TO_REAL(x) ((real)(x))
+#define REAL_INT(x) ((int)(x))
+#define REAL_ROUND(x) ((int)round(x))
+#define REAL_MUL(a,b) ((a) * (b))
+#define REAL_FLOAT(x) (x)
+#define REAL_TRUNC(x) ((int)(x))
+#define Q8_TO_REAL(x) ((x) / 256.0)
+#define REAL_TO_Q8(x) ((int16_t)((x) * 256))
+#endif
+
 // Holds a coordinate
 typedef struct {
-    float x, y;
+    real x, y;
 } Coord;
 
+// Sprite ids, see sprites[]
+typedef enum { SPR_TOM, SPR_JERRY, SPR_SUPER, SPR_CHEESE, SPR_TRAP, SPR_MILK, SPR_DOOR, SPR_FIREWORK } sprite_id;
+
+// Size and bitmap shared by every object of one type
+typedef struct {
+	uint8_t w;
+	uint8_t h;
+	const uint8_t* bitmap; // column-major, in flash
+} Sprite;
+
 // Any static object
 typedef struct {
-	int active; // active/inactive
 	Coord pos; // position
-	int w;
-	int h;
-	uint8_t* bitmap;
+	uint8_t sprite; // sprite_id
 } Object;
 
+// sprites[] is in flash
+#define OBJ_W(o) pgm_read_byte(&sprites[(o)->sprite].w)
+#define OBJ_H(o) pgm_read_byte(&sprites[(o)->sprite].h)
+#define OBJ_BITMAP(o) ((const uint8_t*)pgm_read_ptr(&sprites[(o)->sprite].bitmap))
+
 // Any mobile object
 typedef struct {
 	Object obj;
 	Coord origin;
     Coord d; // dx, dy
-    float speed;
+    real speed;
 } Mobile;
 
 // Wall data
 typedef struct {
-	Mobile data;
 	int line[4]; // x1, y1, x2, y2
+	real step[2]; // unit vector perpendicular to the wall
+	real frac[2]; // sub-pixel movement not applied to line yet
 } Wall;
 
 // Player data (or npc)
 typedef struct {
     Mobile data;
-    int droppable;
-    int lives;
+    uint8_t lives;
     int score;
 } Player;
 
+// Fixed pool of slots. Live slots are bits in a mask, free ones sit
+// on a stack, so allocation and release are O(1).
+typedef struct {
+	uint32_t live; // bit per slot in use
+	uint8_t* free; // stack of unused slots
+	uint8_t free_count;
+} Pool;
+
+// Pool masks are 32 bits, the wall mask 8
+typedef char pool_size_check[(MAX_CHEESE <= 32 && MAX_TRAPS <= 32 && MAX_FIREWORKS <= 32 && MAX_WALLS <= 8) ? 1 : -1];
+
+#define POOL_LIVE(pool, i) (((pool).live >> (i)) & 1)
+#define POOL_COUNT(pool) __builtin_popcountl((pool).live)
+#define WALL_LIVE(i) ((game.wall_live >> (i)) & 1)
+
 // Game state
 typedef struct {
 	Wall walls[MAX_WALLS];
 	Object cheese[MAX_CHEESE];
 	Object traps[MAX_TRAPS];
-	Mobile fireworks[MAX_FIREWORKS];
+	Object fireworks[MAX_FIREWORKS];
 	Object milk;
 	Object door;
-	int level;
-	int cheese_count;
-	int cheese_count_level;
-	int cheese_timer;
-	int trap_timer;
-	int super_timer;
-	int milk_timer;
-	int super_mode;
-	GAME_STATE state;
+	Pool cheese_pool;
+	Pool trap_pool;
+	Pool firework_pool;
+	uint8_t cheese_free[MAX_CHEESE];
+	uint8_t trap_free[MAX_TRAPS];
+	uint8_t firework_free[MAX_FIREWORKS];
+	uint8_t wall_live; // bit per active wall
+	uint8_t milk_active;
+	uint8_t door_active;
+	uint8_t level;
+	uint16_t cheese_count;
+	uint8_t cheese_count_level;
+	uint8_t super_mode;
 } Game;
 
 GAME_STATE game_state;
 
 
+/*
+**  Sprites are written row by row, left-aligned in a byte, and padded to
+**  8 rows. SPRITE() transposes them into column-major bytes (bit 0 = top
+**  row) as constant expressions, so the compiler emits the blitter's
+**  layout straight into flash.
+*/
+#define SPRITE_BIT(r, row, col) ((((r) >> (7 - (col))) & 1) << (row))
+#define SPRITE_COL(c, r0, r1, r2, r3, r4, r5, r6, r7) ( \
+	SPRITE_BIT(r0, 0, c) | SPRITE_BIT(r1, 1, c) | SPRITE_BIT(r2, 2, c) | SPRITE_BIT(r3, 3, c) | \
+	SPRITE_BIT(r4, 4, c) | SPRITE_BIT(r5, 5, c) | SPRITE_BIT(r6, 6, c) | SPRITE_BIT(r7, 7, c))
+#define SPRITE(...) { \
+	SPRITE_COL(0, __VA_ARGS__), SPRITE_COL(1, __VA_ARGS__), SPRITE_COL(2, __VA_ARGS__), SPRITE_COL(3, __VA_ARGS__), \
+	SPRITE_COL(4, __VA_ARGS__), SPRITE_COL(5, __VA_ARGS__), SPRITE_COL(6, __VA_ARGS__), SPRITE_COL(7, __VA_ARGS__) }
+
 // Tom bitmap
-uint8_t tom_original[7] = {
-    0b10001000,
+const uint8_t tom_bitmap[8] PROGMEM = SPRITE(
+	0b10001000,
 	0b11011000,
 	0b11111000,
 	0b10101000,
 	0b11111000,
 	0b11111000,
 	0b01110000,
-};
-uint8_t tom_direct[7];
+	0
+);
 
 // Jerry bitmap
-uint8_t jerry_original[6] = {
+const uint8_t jerry_bitmap[8] PROGMEM = SPRITE(
 	0b11011000,
 	0b11011000,
 	0b11011000,
 	0b01110000,
 	0b01110000,
 	0b01110000,
-};
-uint8_t jerry_direct[6];
+	0, 0
+);
 
 // Jerry super mode
-uint8_t super_original[8] = {
+const uint8_t super_bitmap[8] PROGMEM = SPRITE(
 	0b11001100,
 	0b11111100,
 	0b11111100,
@@ -146,49 +275,65 @@ uint8_t super_original[8] = {
 	0b01111000,
 	0b01111000,
 	0b01111000,
-	0b00110000,						
-};
-uint8_t super_direct[8];
+	0b00110000
+);
 
 // Cheese bitmap
-uint8_t cheese_original[3] = {
+const uint8_t cheese_bitmap[8] PROGMEM = SPRITE(
 	0b11100000,
 	0b10000000,
 	0b11100000,
-};
-uint8_t cheese_direct[3];
+	0, 0, 0, 0, 0
+);
 
 // Trap bitmap
-uint8_t trap_original[3] = {
+const uint8_t trap_bitmap[8] PROGMEM = SPRITE(
 	0b10000000,
 	0b01000000,
 	0b11100000,
-};
-uint8_t trap_direct[3];
+	0, 0, 0, 0, 0
+);
 
 // Milk bitmap
-uint8_t milk_original[3] = {
+const uint8_t milk_bitmap[8] PROGMEM = SPRITE(
 	0b01001000,
 	0b11111100,
 	0b10000100,
-};
-uint8_t milk_direct[3];
+	0, 0, 0, 0, 0
+);
 
 // Door bitmap
-uint8_t door_original[5] = {
+const uint8_t door_bitmap[8] PROGMEM = SPRITE(
 	0b11111000,
 	0b10001000,
 	0b10001000,
 	0b10001000,
 	0b10001000,
-};
-uint8_t door_direct[5];
+	0, 0, 0
+);
 
 // Firework bitmap
-uint8_t firework_original[1] = {
+const uint8_t firework_bitmap[8] PROGMEM = SPRITE(
 	0b10000000,
+	0, 0, 0, 0, 0, 0, 0
+);
+
+// Indexed by sprite_id
+const Sprite sprites[] PROGMEM = {
+	{ MAX_CHAR_WIDTH, MAX_CHAR_HEIGHT, tom_bitmap },
+	{ MAX_CHAR_WIDTH, MAX_CHAR_HEIGHT, jerry_bitmap },
+	{ 6, 8, super_bitmap },
+	{ SM_OBJ_WIDTH, SM_OBJ_HEIGHT, cheese_bitmap },
+	{ SM_OBJ_WIDTH, SM_OBJ_HEIGHT, trap_bitmap },
+	{ MILK_WIDTH, SM_OBJ_HEIGHT, milk_bitmap },
+	{ MD_OBJ_WIDTH, MD_OBJ_HEIGHT, door_bitmap },
+	{ TN_OBJ_WIDTH, TN_OBJ_HEIGHT, firework_bitmap },
 };
-uint8_t firework_direct[1];
+
+// broad_query() only looks BROAD_REACH px up and left of a binned corner
+_Static_assert(SM_OBJ_WIDTH <= BROAD_REACH && SM_OBJ_HEIGHT <= BROAD_REACH && MILK_WIDTH <= BROAD_REACH
+	&& MD_OBJ_WIDTH <= BROAD_REACH && MD_OBJ_HEIGHT <= BROAD_REACH && TN_OBJ_WIDTH <= BROAD_REACH
+	&& TN_OBJ_HEIGHT <= BROAD_REACH, "a broad phase sprite is bigger than BROAD_REACH");
 
 Player jerry;
 Player tom;
@@ -215,21 +360,117 @@ volatile uint8_t sw_j_center;
 volatile uint8_t sw_b_left;
 volatile uint8_t sw_b_right;
 
+// Debounced input edges, pushed by the timer 1 ISR and drained once per
+// frame. Single producer/single consumer: only the ISR writes
+// input_head, only the main loop writes input_tail.
+typedef struct {
+	uint8_t input; // input_id
+	uint8_t pressed; // 1 press, 0 release
+	uint32_t ms; // game clock at the edge
+} InputEvent;
+
+volatile InputEvent input_queue[INPUT_QUEUE];
+volatile uint8_t input_head;
+volatile uint8_t input_tail;
+volatile uint8_t input_held; // bit per input_id
+volatile uint8_t input_dropped; // events lost to a full queue
+uint32_t input_stamp; // oldest press handled this frame
+uint8_t input_waiting; // 1 while that press has not reached the LCD
+uint16_t input_latency_max; // worst press to frame sent time in ms
+
 // timing variables
 volatile uint8_t overflow_counter0 = 0;
 volatile uint32_t overflow_counter1 = 0;
-volatile uint32_t overflow_counter3 = 0;
-volatile float time_sec=0;
-volatile int time_min=0;
+volatile uint32_t clock_ms = 0; // game clock, stops while paused
+volatile uint8_t wall_ticks_pending = 0; // wall steps due, set by the timer 1 ISR
+uint32_t now_ms; // clock_ms sampled once per frame
 
 // other vars
 int left_right_click, up_down_click;
-volatile int duty_cycle_r=0;
-volatile int duty_cycle_l=0;
+volatile uint8_t duty_cycle_r=0; // 0-254, published by the ADC ISR
+volatile uint8_t duty_cycle_l=0;
+
+// Level 2 telemetry. Frame: SYNC, length, seq, field mask (16 bit),
+// one 16 bit value per set mask bit, CRC-16/CCITT over length..values.
+// Multi-byte values are little endian.
+uint16_t tm_sent[TM_COUNT]; // values as last queued
+uint8_t tm_seq;
+uint8_t tm_frames; // frames since the last send
+uint16_t tm_lost; // frames dropped because the ring was full
+uint8_t tx_ring[TX_RING];
+uint8_t tx_head, tx_tail;
+
+// Free-running ADC state, owned by the ADC ISR
+uint8_t adc_channel; // channel the running conversion will sample next
+uint8_t adc_skip; // conversions still to drop after a channel change
+uint8_t adc_count;
+uint16_t adc_sum;
+volatile uint8_t adc_ready; // bit per channel published at least once
+volatile uint8_t adc_entropy; // LSB noise from every conversion, for the seed
 char buffer[80];
-int wall_num; // for loading walls via serial
+
+// Room being streamed in over USB. Records are lines of "T x y",
+// "J x y", "W x1 y1 x2 y2" and an optional "E" to end the room, or a
+// single "R n" to play level pack room n. The room is staged here and
+// only replaces the current one once complete.
+typedef struct {
+	int walls[MAX_WALLS][4];
+	uint8_t wall_count;
+	uint8_t has_tom, has_jerry;
+	Coord tom, jerry;
+} Room;
+
+Room room_stage;
+
+/*
+**  Level pack, in the binary room format (room.h). Generated by roomc
+**  from rooms.txt with the wall masks rasterised, see the Makefile.
+*/
+#include "level_pack.h"
+uint8_t room_state; // room_step
+uint8_t room_usb_started;
+char room_record; // record type being parsed
+uint8_t room_field; // fields completed in the record
+int room_ints[4]; // whole parts of the fields
+real room_reals[2]; // T/J fields with their fractions
+uint8_t room_digits; // digits in the current field, 0 before it starts
+uint8_t room_neg;
+uint8_t room_point; // past the decimal point
+int room_whole;
+uint16_t room_frac, room_frac_div;
+uint32_t room_last_ms; // when the last byte arrived
+uint16_t room_errors; // records rejected
+uint8_t wall_mask[LCD_BUFFER_SIZE]; // 1 bit per wall pixel, same bank layout as the LCD
+
+// Free-space grid for spawning
+uint8_t grid_objs[GRID_ROWS][GRID_COLS]; // objects touching each cell
+uint8_t grid_walls[GRID_ROWS][GRID_COLS]; // 1 if a wall pixel is in the cell
+uint8_t grid_row_free[GRID_ROWS]; // free cells per row
+int grid_free; // free cells in total
+uint16_t spawn_latency_max; // worst find_clear time in us (timer 1 ticks)
+uint16_t spawn_steps_max; // worst find_clear work: rows and cells stepped plus footprints tried
+
+// Dirty column range per LCD bank (lo > hi when clean)
+uint8_t dirty_lo[LCD_BANKS], dirty_hi[LCD_BANKS]; // drawn this frame
+uint8_t prev_dirty_lo[LCD_BANKS], prev_dirty_hi[LCD_BANKS]; // drawn last frame
+int drawn_walls[MAX_WALLS][5]; // active + line of each wall as last drawn
+char drawn_status[sizeof(buffer)]; // status bar text as last drawn
+
+// Broad phase grid. Objects are linked into the cell holding their
+// top-left corner, pickups and fireworks in separate lists.
+uint8_t broad_pickups[BROAD_ROWS * BROAD_COLS]; // first id in each cell
+uint8_t broad_fireworks[BROAD_ROWS * BROAD_COLS];
+uint8_t broad_next[BROAD_IDS]; // next id in the same cell
 int supertimer;
 
+// Timer wheel. Each pending event sits in the list of the slot its
+// deadline falls in; only the slots the clock has reached are scanned.
+uint32_t wheel_deadline[EV_COUNT]; // ms
+uint8_t wheel_next[EV_COUNT]; // next event in the same slot
+uint8_t wheel_slot[EV_COUNT]; // WHEEL_NONE when not scheduled
+uint8_t wheel_head[WHEEL_SLOTS];
+uint32_t wheel_tick; // next slot tick to scan
+
 // -------------------------------------------------
 // Helper functions.
 // -------------------------------------------------
@@ -283,33 +524,112 @@ void usb_serial_send(char * message) {
 	usb_serial_write((uint8_t *) message, strlen(message));
 }
 
-void usb_serial_read_string(char * message){
-	int c = 0;
-	int buffer_count=0;
-      
-    while (c != '\n'){
-			c = usb_serial_getchar();
-			if(c == -1) break;
-			message[buffer_count]=c;
-			buffer_count++;
-	}
-}
-
 int randInRange(int min, int max) {
 	int out = min + rand()%(max+1 - min);
 	return out;
 }
 
+// Empty a pool. Slot 0 is handed out first.
+void pool_init(Pool* pool, uint8_t* free, uint8_t size) {
+	pool->live = 0;
+	pool->free = free;
+	pool->free_count = size;
+	for (uint8_t i = 0; i < size; i++) free[i] = size - 1 - i;
+}
+
+// Take a free slot, -1 if the pool is full
+int pool_alloc(Pool* pool) {
+	if (pool->free_count == 0) return -1;
+	uint8_t i = pool->free[--pool->free_count];
+	pool->live |= (uint32_t)1 << i;
+	return i;
+}
+
+void pool_release(Pool* pool, uint8_t i) {
+	if (!POOL_LIVE(*pool, i)) return;
+	pool->live &= ~((uint32_t)1 << i);
+	pool->free[pool->free_count++] = i;
+}
+
+/*
+**	Pop the lowest live slot off a copy of a live mask.
+**  for (uint32_t m = pool.live; m; ) { int i = pool_pop(&m); ... }
+*/
+uint8_t pool_pop(uint32_t* mask) {
+	uint8_t i = __builtin_ctzl(*mask);
+	*mask &= *mask - 1;
+	return i;
+}
+
+// -------------------------------------------------
+// Lookup table trig.
+// Angles are binary: 256 units per turn, counter-clockwise, 0 = +x.
+// -------------------------------------------------
+typedef uint8_t angle_t;
+#define ANGLE_QUARTER 64
+
+// sin of 0..90 degrees in Q8.8
+const uint16_t sin_table[ANGLE_QUARTER + 1] PROGMEM = {
+	0, 6, 13, 19, 25, 31, 38, 44, 50, 56, 62, 68, 74, 80, 86, 92,
+	98, 104, 109, 115, 121, 126, 132, 137, 142, 147, 152, 157, 162, 167, 172, 177,
+	181, 185, 190, 194, 198, 202, 206, 209, 213, 216, 220, 223, 226, 229, 231, 234,
+	237, 239, 241, 243, 245, 247, 248, 250, 251, 252, 253, 254, 255, 255, 256, 256,
+	256,
+};
+
+// atan(i/32) in binary angle units, for the first octant
+const uint8_t atan_table[33] PROGMEM = {
+	0, 1, 3, 4, 5, 6, 8, 9, 10, 11, 12, 13, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 25, 26, 27, 28, 29, 29, 30, 31, 31,
+	32,
+};
+
+real sin_real(angle_t a) {
+	uint8_t i = a & 0x7F; // fold onto the first half turn
+	if (i > ANGLE_QUARTER) i = 2 * ANGLE_QUARTER - i;
+	int16_t v = pgm_read_word(&sin_table[i]);
+	if (a & 0x80) v = -v;
+	return Q8_TO_REAL(v);
+}
+
+real cos_real(angle_t a) {
+	return sin_real(a + ANGLE_QUARTER);
+}
+
+/*
+**	atan2 on the binary circle.
+**  Reduces to the first octant, looks up the ratio, then mirrors back.
+*/
+angle_t angle_atan2(int16_t y, int16_t x) {
+	if (x == 0 && y == 0) return 0;
+	uint16_t ax = (x < 0) ? -x : x;
+	uint16_t ay = (y < 0) ? -y : y;
+
+	// Keep the ratio maths in 16 bits
+	while ((ax | ay) >= 0x0400) {
+		ax >>= 1;
+		ay >>= 1;
+	}
+
+	angle_t a;
+	if (ay <= ax) a = pgm_read_byte(&atan_table[((ay << 5) + (ax >> 1)) / ax]);
+	else a = ANGLE_QUARTER - pgm_read_byte(&atan_table[((ax << 5) + (ay >> 1)) / ay]);
+
+	if (x < 0) a = 2 * ANGLE_QUARTER - a;
+	if (y < 0) a = -a;
+	return a;
+}
+
 // make bounce directions random
 void rand_direction(Mobile* mob, int x, int y) {
-    float dir = rand() * M_PI * 2 / RAND_MAX;
+    angle_t dir = rand();
 	int num = randInRange(0, (JERRY_SPEED - TOM_SPEED)*10);
     
-    float speed = TOM_SPEED + num/10;
+    real speed = FLOAT_TO_REAL(TOM_SPEED) + TO_REAL(num/10);
     //if (step < 0.1) step = 0.1;
 
-	if (x) mob->d.x = speed * cos(dir);
-	if (y) mob->d.y = speed * sin(dir);
+	if (x) mob->d.x = REAL_MUL(speed, cos_real(dir));
+	if (y) mob->d.y = REAL_MUL(speed, sin_real(dir));
 	mob->speed = speed;
 }
 
@@ -340,30 +660,60 @@ void fade_out() {
 }
 
 void start_timer3(){
-	SET_BIT(TCCR3B,CS32);     //1 see table 14-6
-	SET_BIT(TCCR3B,CS30);   //0	
+	SET_BIT(TCCR3B,CS31);     //1 see table 14-6
+	SET_BIT(TCCR3B,CS30);   //1
 }
 
 void stop_timer3(){
-	CLEAR_BIT(TCCR3B,CS32);     //1 see table 14-6
-	CLEAR_BIT(TCCR3B,CS30);   //0	
+	CLEAR_BIT(TCCR3B,CS31);     //1 see table 14-6
+	CLEAR_BIT(TCCR3B,CS30);   //1
 }
 
 void reset_timer3(){
-	TCNT3 = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TCNT3 = 0;
+		clock_ms = 0;
+	}
 }
 
-int get_current_time(){
-
-	time_sec = ( overflow_counter3 * 65535.0 + TCNT3 ) * PRESCALE3  / FREQ;
-	
-	if (time_sec >= 60.00) {
-		overflow_counter3 = 0.0;
-		time_min++;
-        time_sec = 0.0;
+/*
+**  Read the game clock. The 32 bit counter is updated in an ISR, so the
+**  read is done with interrupts off to avoid a torn value.
+*/
+uint32_t clock_millis(void) {
+	uint32_t ms;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ms = clock_ms;
 	}
+	return ms;
+}
+
+// Take an event off its slot list, if it is on one
+void wheel_cancel(uint8_t ev) {
+	if (wheel_slot[ev] == WHEEL_NONE) return;
+	uint8_t* link = &wheel_head[wheel_slot[ev]];
+	while (*link != ev) link = &wheel_next[*link];
+	*link = wheel_next[ev];
+	wheel_slot[ev] = WHEEL_NONE;
+}
 
-return (int)time_sec;
+// (Re)schedule an event for an absolute game clock time
+void wheel_schedule(uint8_t ev, uint32_t deadline) {
+	wheel_cancel(ev);
+	uint32_t tick = deadline >> WHEEL_SHIFT;
+	if (tick < wheel_tick) tick = wheel_tick; // already due, scan next
+	uint8_t slot = tick & (WHEEL_SLOTS - 1);
+	wheel_deadline[ev] = deadline;
+	wheel_slot[ev] = slot;
+	wheel_next[ev] = wheel_head[slot];
+	wheel_head[slot] = ev;
+}
+
+// Drop every event and restart from clock 0
+void wheel_reset() {
+	memset(wheel_head, WHEEL_NONE, sizeof(wheel_head));
+	memset(wheel_slot, WHEEL_NONE, sizeof(wheel_slot));
+	wheel_tick = 0;
 }
 
 
@@ -372,43 +722,250 @@ int set_state(uint8_t mask, uint8_t bit_counter) {
 	return (bit_counter == mask);
 }
 
+// ISR side: queue an input edge, or count it as dropped when full
+void input_push(uint8_t input, uint8_t pressed) {
+	uint8_t next = (input_head + 1) & (INPUT_QUEUE - 1);
+	if (next == input_tail) {
+		input_dropped++;
+		return;
+	}
+	input_queue[input_head].input = input;
+	input_queue[input_head].pressed = pressed;
+	input_queue[input_head].ms = clock_ms;
+	input_head = next;
+}
+
+// Main loop side: take the oldest event, 0 when there is none
+int input_pop(InputEvent* ev) {
+	uint8_t tail = input_tail;
+	if (tail == input_head) return 0;
+	ev->input = input_queue[tail].input;
+	ev->pressed = input_queue[tail].pressed;
+	ev->ms = input_queue[tail].ms;
+	input_tail = (tail + 1) & (INPUT_QUEUE - 1);
+	return 1;
+}
+
+void input_flush(void) {
+	input_tail = input_head;
+}
+
 // Find direction between two points
-float get_direction(float x1, float y1, float x2, float y2) {
-    float x = x2 - x1;
-    float y = y1 - y2;
-    return atan2(y,x);
+angle_t get_direction(real x1, real y1, real x2, real y2) {
+    real x = x2 - x1;
+    real y = y1 - y2;
+    return angle_atan2(REAL_TO_Q8(y), REAL_TO_Q8(x));
 }
 
 float pursuit(Mobile* pursuer, Mobile* target) {
   int pd = PURSUIT_DELAY;
-  float future_pos = get_direction(pursuer->obj.pos.x, pursuer->obj.pos.y, target->obj.pos.x, target->obj.pos.y) + target->speed * pd;
+  float future_pos = get_direction(pursuer->obj.pos.x, pursuer->obj.pos.y, target->obj.pos.x, target->obj.pos.y) + REAL_FLOAT(target->speed) * pd;
   return future_pos;
 } 
 
 void update_pursuer(Mobile* pursuer, Mobile* target) {
   float future_pos = pursuit(pursuer, target);
   future_pos = trunc(future_pos);
-  int velocity = trunc (pursuer->speed + future_pos);
-  pursuer->obj.pos.x += velocity;
-  pursuer->obj.pos.y += velocity;
+  int velocity = trunc (REAL_FLOAT(pursuer->speed) + future_pos);
+  pursuer->obj.pos.x += TO_REAL(velocity);
+  pursuer->obj.pos.y += TO_REAL(velocity);
+}
+
+int grid_cell_free(int r, int c) {
+	return r >= GRID_TOP && grid_objs[r][c] == 0 && grid_walls[r][c] == 0;
+}
+
+// Recount the free cells of every row
+void grid_recount() {
+	grid_free = 0;
+	for(int r=0; r < GRID_ROWS; r++) {
+		grid_row_free[r] = 0;
+		for(int c=0; c < GRID_COLS; c++) {
+			if(grid_cell_free(r, c)) grid_row_free[r]++;
+		}
+		grid_free += grid_row_free[r];
+	}
+}
+
+// Does grid cell (r, c) hold any wall pixel
+uint8_t grid_wall_hit(int r, int c) {
+	int bank = (r * GRID_CELL) >> 3;
+	uint8_t bits = ((1 << GRID_CELL) - 1) << ((r * GRID_CELL) & 7);
+	uint8_t hit = 0;
+	for (int x = c * GRID_CELL; x < (c + 1) * GRID_CELL; x++) {
+		hit |= wall_mask[bank * LCD_X + x] & bits;
+	}
+	return hit != 0;
+}
+
+// Mark which cells hold wall pixels, for a whole new room
+void grid_update_walls() {
+	for(int r=0; r < GRID_ROWS; r++) {
+		for(int c=0; c < GRID_COLS; c++) {
+			grid_walls[r][c] = grid_wall_hit(r, c);
+		}
+	}
+	grid_recount();
+}
+
+/*
+**	Redo only the cells under a wall line's bounding box, and move the
+**  free counts by the cells that changed. Off-screen parts are skipped.
+*/
+void grid_update_walls_box(int line[]) {
+	int c1 = (MIN(line[0], line[2])) / GRID_CELL;
+	int c2 = (MAX(line[0], line[2])) / GRID_CELL;
+	int r1 = (MIN(line[1], line[3])) / GRID_CELL;
+	int r2 = (MAX(line[1], line[3])) / GRID_CELL;
+	if(c1 < 0) c1 = 0;
+	if(r1 < 0) r1 = 0;
+	if(c2 >= GRID_COLS) c2 = GRID_COLS - 1;
+	if(r2 >= GRID_ROWS) r2 = GRID_ROWS - 1;
+
+	for(int r = r1; r <= r2; r++) {
+		for(int c = c1; c <= c2; c++) {
+			uint8_t hit = grid_wall_hit(r, c);
+			if(hit == grid_walls[r][c]) continue;
+			int was_free = grid_cell_free(r, c);
+			grid_walls[r][c] = hit;
+			int now_free = grid_cell_free(r, c);
+			if(was_free && !now_free) { grid_row_free[r]--; grid_free--; }
+			if(!was_free && now_free) { grid_row_free[r]++; grid_free++; }
+		}
+	}
+}
+
+/*
+**	Add (delta = 1) or remove (delta = -1) an object from the grid.
+**  Must be called with the same position it was added with.
+*/
+void grid_mark_object(Object* obj, int delta) {
+	int c1 = REAL_INT(obj->pos.x) / GRID_CELL;
+	int r1 = REAL_INT(obj->pos.y) / GRID_CELL;
+	int c2 = (REAL_INT(obj->pos.x) + OBJ_W(obj) - 1) / GRID_CELL;
+	int r2 = (REAL_INT(obj->pos.y) + OBJ_H(obj) - 1) / GRID_CELL;
+
+	for(int r = r1; r <= r2; r++) {
+		if(r < 0 || r >= GRID_ROWS) continue;
+		for(int c = c1; c <= c2; c++) {
+			if(c < 0 || c >= GRID_COLS) continue;
+			int was_free = grid_cell_free(r, c);
+			if(delta > 0) grid_objs[r][c]++;
+			else if(grid_objs[r][c] > 0) grid_objs[r][c]--;
+			int now_free = grid_cell_free(r, c);
+			if(was_free && !now_free) { grid_row_free[r]--; grid_free--; }
+			if(!was_free && now_free) { grid_row_free[r]++; grid_free++; }
+		}
+	}
+}
+
+void grid_reset_objects() {
+	memset(grid_objs, 0, sizeof(grid_objs));
+	grid_recount();
+}
+
+/*
+**	Rebuild the wall mask from scratch.
+**  Call whenever walls are added, removed or moved.
+*/
+void update_wall_mask() {
+	memset(wall_mask, 0, sizeof(wall_mask));
+	for(int i=0; i < MAX_WALLS; i++) {
+		if(WALL_LIVE(i)) raster_wall(game.walls[i].line, 1);
+	}
+	grid_update_walls();
+}
+
+// Look up a pixel in the wall mask
+int check_wall(int obj_x, int obj_y) {
+	if (obj_x < 0 || obj_x >= LCD_X || obj_y < 0 || obj_y >= LCD_Y) return 0;
+	return BIT_VALUE(wall_mask[(obj_y >> 3) * LCD_X + obj_x], (obj_y & 7));
+}
+
+// Do the bounding boxes of two wall lines overlap
+int wall_boxes_overlap(int a[], int b[]) {
+	if ((a[0] < b[0] && a[0] < b[2] && a[2] < b[0] && a[2] < b[2]) ||
+		(a[0] > b[0] && a[0] > b[2] && a[2] > b[0] && a[2] > b[2]) ||
+		(a[1] < b[1] && a[1] < b[3] && a[3] < b[1] && a[3] < b[3]) ||
+		(a[1] > b[1] && a[1] > b[3] && a[3] > b[1] && a[3] > b[3])) return 0;
+	return 1;
+}
+
+/*
+**	Patch the wall mask after some walls moved.
+**  Clears the old segments of moved walls, then redraws the moved walls
+**  plus any still wall that shared pixels with a cleared segment. The
+**  grid is patched the same way, under the moved walls' boxes only.
+*/
+void update_wall_mask_moved(int old_lines[][4], uint8_t moved[]) {
+	int any = 0;
+	for(int i=0; i < MAX_WALLS; i++) {
+		if(moved[i]) {
+			raster_wall(old_lines[i], 0);
+			any = 1;
+		}
+	}
+	if(!any) return;
+
+	for(int i=0; i < MAX_WALLS; i++) {
+		if(!WALL_LIVE(i)) continue;
+		if(moved[i]) {
+			raster_wall(game.walls[i].line, 1);
+			continue;
+		}
+		for(int j=0; j < MAX_WALLS; j++) {
+			if(moved[j] && wall_boxes_overlap(game.walls[i].line, old_lines[j])) {
+				raster_wall(game.walls[i].line, 1);
+				break;
+			}
+		}
+	}
+
+	// Pixels only changed under the old and new boxes of the moved walls
+	for(int i=0; i < MAX_WALLS; i++) {
+		if(!moved[i]) continue;
+		grid_update_walls_box(old_lines[i]);
+		grid_update_walls_box(game.walls[i].line);
+	}
+}
+
+/*
+**  Work out a wall's direction of travel once, when it is placed: the
+**  unit vector perpendicular to the line. Walls only ever translate, so
+**  it never changes after that.
+*/
+void wall_init_step(Wall* wall) {
+	int diff_x = wall->line[2] - wall->line[0];
+	int diff_y = wall->line[3] - wall->line[1];
+	angle_t angle = angle_atan2(diff_y, diff_x) + ANGLE_QUARTER; // To find the perpendicular
+	wall->step[0] = cos_real(angle);
+	wall->step[1] = -sin_real(angle);
+	wall->frac[0] = 0;
+	wall->frac[1] = 0;
 }
 
 void move_walls() {
+	int old_lines[MAX_WALLS][4];
+	uint8_t moved[MAX_WALLS];
+	real speed = TO_REAL(duty_cycle_r >> 2) / WALL_SPEED_DIV; // px per tick
+
 	for(int i=0; i < MAX_WALLS; i++) {
-		if(game.walls[i].data.obj.active == 1) {
-			//first convert line to normalized unit vector
-			float diff_x = game.walls[i].line[2] - game.walls[i].line[0];
-			float diff_y = game.walls[i].line[3] - game.walls[i].line[1];
-			float angle = atan2(diff_y, diff_x);
-			angle += M_PI/2; // To find the perpendicular
-			float dist_x = 1 * cos(angle);
-			float dist_y = -1 * sin(angle);
-
-			//  + (duty_cycle_r/100)
-			game.walls[i].line[0] += dist_x+ (duty_cycle_r/100); // x1
-			game.walls[i].line[1] += dist_y+ (duty_cycle_r/100); // y1
-			game.walls[i].line[2] += dist_x+ (duty_cycle_r/100); // x2
-			game.walls[i].line[3] += dist_y+ (duty_cycle_r/100); // y2
+		moved[i] = 0;
+		if(WALL_LIVE(i)) {
+			memcpy(old_lines[i], game.walls[i].line, sizeof(old_lines[i]));
+
+			// Accumulate, and move the line by the whole pixels
+			game.walls[i].frac[0] += REAL_MUL(game.walls[i].step[0], speed);
+			game.walls[i].frac[1] += REAL_MUL(game.walls[i].step[1], speed);
+			int step_x = REAL_TRUNC(game.walls[i].frac[0]);
+			int step_y = REAL_TRUNC(game.walls[i].frac[1]);
+			game.walls[i].frac[0] -= TO_REAL(step_x);
+			game.walls[i].frac[1] -= TO_REAL(step_y);
+
+			game.walls[i].line[0] += step_x; // x1
+			game.walls[i].line[1] += step_y; // y1
+			game.walls[i].line[2] += step_x; // x2
+			game.walls[i].line[3] += step_y; // y2
 
 			if(game.walls[i].line[0] > LCD_X && game.walls[i].line[2] > LCD_X) {
 				game.walls[i].line[0] -= LCD_X-1; 
@@ -419,18 +976,21 @@ void move_walls() {
 				game.walls[i].line[3] -= LCD_Y+GAME_CEILING-1;
 			}
 
-			// if(game.walls[i].line[0] < LCD_X && game.walls[i].line[2] < LCD_X) {
-			// 	game.walls[i].line[0] += LCD_X+1; 
-			// 	game.walls[i].line[2] += LCD_X+1; 
-			// }
-			// if(game.walls[i].line[1] < GAME_CEILING && game.walls[i].line[3] < GAME_CEILING) {
-			// 	game.walls[i].line[1] += LCD_Y-GAME_CEILING+1;
-			// 	game.walls[i].line[3] += LCD_Y-GAME_CEILING+1;
-			// }			
-
+			// Same again for walls travelling left or up
+			if(game.walls[i].line[0] < 0 && game.walls[i].line[2] < 0) {
+				game.walls[i].line[0] += LCD_X-1; 
+				game.walls[i].line[2] += LCD_X-1; 
+			}
+			if(game.walls[i].line[1] < 1-GAME_CEILING && game.walls[i].line[3] < 1-GAME_CEILING) {
+				game.walls[i].line[1] += LCD_Y+GAME_CEILING-1;
+				game.walls[i].line[3] += LCD_Y+GAME_CEILING-1;
+			}
 
+			// Includes the wrap-around jumps above
+			moved[i] = memcmp(old_lines[i], game.walls[i].line, sizeof(old_lines[i])) != 0;
 		}
 	}
+	update_wall_mask_moved(old_lines, moved);
 }
 
 // Use for main game timer
@@ -479,6 +1039,15 @@ ISR(TIMER1_OVF_vect) {
 	sw_j_center = set_state(DEBOUNCE_MASK, bc_j_center);
 	sw_b_left = set_state(DEBOUNCE_MASK, bc_b_left);
 	sw_b_right = set_state(DEBOUNCE_MASK, bc_b_right);		
+
+	// Queue the edges
+	uint8_t held = sw_j_up << IN_J_UP | sw_j_down << IN_J_DOWN | sw_j_left << IN_J_LEFT | sw_j_right << IN_J_RIGHT
+		| sw_j_center << IN_J_CENTER | sw_b_left << IN_B_LEFT | sw_b_right << IN_B_RIGHT;
+	uint8_t changed = held ^ input_held;
+	input_held = held;
+	for (uint8_t i = 0; changed; i++, changed >>= 1) {
+		if (changed & 1) input_push(i, (held >> i) & 1);
+	}
 	
     //increments
     // 16 * 65536 = 1048576 micro seconds approx 1.04 sec
@@ -494,14 +1063,61 @@ ISR(TIMER1_OVF_vect) {
     //16 * 65536 = 1048576 micro seconds approx 1.04 sec
     //walls update and LED toggle at 1Hz
     if (overflow_counter1 > 10 && game_state != PAUSE){
-		move_walls();
+		if (wall_ticks_pending < 255) wall_ticks_pending++; // moved by run_wall_ticks
 	    overflow_counter1=0;
 	    //PORTB^=(1<<2);
 	   }	
 }
 
-ISR(TIMER3_OVF_vect) {
-	overflow_counter3 ++;
+// 1 ms game clock
+ISR(TIMER3_COMPA_vect) {
+	clock_ms++;
+}
+
+/*
+**  ADC conversion complete. The ADC free-runs, so by the time this fires
+**  the next conversion has already started on the old channel; the first
+**  result after a channel change is dropped. Each channel is averaged
+**  over 2^ADC_OVERSAMPLE_SHIFT conversions before it is published.
+*/
+ISR(ADC_vect) {
+	uint16_t sample = ADC;
+	adc_entropy = (adc_entropy << 1 | adc_entropy >> 7) ^ sample;
+	if (adc_skip) {
+		adc_skip--;
+		return;
+	}
+
+	adc_sum += sample;
+	if (++adc_count < (1 << ADC_OVERSAMPLE_SHIFT)) return;
+
+	// 10 bit average scaled to 0-254
+	uint8_t duty = adc_sum >> (ADC_OVERSAMPLE_SHIFT + 2);
+	if (duty > 254) duty = 254;
+	if (adc_channel == 0) duty_cycle_l = duty;
+	else duty_cycle_r = duty;
+	adc_ready |= 1 << adc_channel;
+
+	adc_sum = 0;
+	adc_count = 0;
+	adc_channel ^= 1; // ADC0 left wheel, ADC1 right wheel
+	ADMUX = (ADMUX & ~0x1F) | adc_channel;
+	adc_skip = 1;
+}
+
+/*
+**  Apply the wall steps the timer 1 ISR has counted since last frame.
+**  Runs from the main loop so the walls only change between the
+**  collision checks and drawing, never in the middle of them.
+*/
+void run_wall_ticks() {
+	uint8_t ticks;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ticks = wall_ticks_pending;
+		wall_ticks_pending = 0;
+	}
+	if (ticks > WALL_TICKS_MAX) ticks = WALL_TICKS_MAX; // after a long stall
+	while (ticks--) move_walls();
 }
 
 void turnOnLed0( int led ) {
@@ -524,270 +1140,387 @@ float CalcDistanceBetween2Points(int x1, int y1, int x2, int y2)
 }
 
 
-// Modified version of draw_pixel from graphics.c
-int check_wall(int obj_x, int obj_y) {
-	int collided = 0;
-	int x1, y1, x2, y2;
+Coord make_random_coord() {
+    Coord result;
+	result.x = TO_REAL(rand_range(0, LCD_X));
+	result.y = TO_REAL(rand_range(GAME_CEILING, LCD_Y));
+    return result;
+}
 
-	for(int i=0; i < MAX_WALLS; i++) {
-		x1 = game.walls[i].line[0];
-		y1 = game.walls[i].line[1];
-		x2 = game.walls[i].line[2];
-		y2 = game.walls[i].line[3];
-
-		if ( x1 == x2 ) {
-			// Draw vertical line
-			for ( int i = y1; (y2 > y1) ? i <= y2 : i >= y2; (y2 > y1) ? i++ : i-- ) {
-				if(x1 == obj_x && i == obj_y) collided = 1;
-			}
+// Does a box overlap a player
+int box_hits_player(int x, int y, int w, int h, Player* p) {
+	int px = REAL_INT(p->data.obj.pos.x);
+	int py = REAL_INT(p->data.obj.pos.y);
+	return x < px + OBJ_W(&p->data.obj) && px < x + w && y < py + OBJ_H(&p->data.obj) && py < y + h;
+}
+
+// Are cols x rows cells from (r, c) all free and away from Tom and Jerry
+int grid_area_clear(int r, int c, int cols, int rows) {
+	if(r + rows > GRID_ROWS || c + cols > GRID_COLS) return 0;
+	for(int i = r; i < r + rows; i++) {
+		for(int j = c; j < c + cols; j++) {
+			if(!grid_cell_free(i, j)) return 0;
 		}
-		else if ( y1 == y2 ) {
-			// Draw horizontal line
-			for ( int i = x1; (x2 > x1) ? i <= x2 : i >= x2; (x2 > x1) ? i++ : i-- ) {
-				if(i == obj_x && y1 == obj_y) collided = 1;
-			}
+	}
+	int x = c * GRID_CELL, y = r * GRID_CELL;
+	int w = cols * GRID_CELL, h = rows * GRID_CELL;
+	return !box_hits_player(x, y, w, h, &tom) && !box_hits_player(x, y, w, h, &jerry);
+}
+
+/*
+**	Place an object on a random clear spot.
+**  Picks a random free grid cell, then walks forward in scan order until
+**  the object's footprint fits, so it never visits more than every cell once.
+**  Returns 0 if there is no room.
+*/
+int find_clear(Object* obj) {
+	uint16_t start = TCNT1;
+	int w = OBJ_W(obj), h = OBJ_H(obj);
+	int cols = (w + GRID_CELL - 1) / GRID_CELL;
+	int rows = (h + GRID_CELL - 1) / GRID_CELL;
+	int found = 0;
+	int r = GRID_TOP, c = 0;
+	uint16_t steps = 0;
+
+	if(grid_free > 0) {
+		// Find the k-th free cell
+		int k = rand() % grid_free;
+		while(k >= grid_row_free[r]) {
+			k -= grid_row_free[r];
+			r++;
+			steps++;
+		}
+		for(c = 0; c < GRID_COLS; c++) {
+			steps++;
+			if(grid_cell_free(r, c) && k-- == 0) break;
 		}
-		else {
-			//	Always draw from left to right, regardless of the order the endpoints are 
-			//	presented.
-			if ( x1 > x2 ) {
-				int t = x1;
-				x1 = x2;
-				x2 = t;
-				t = y1;
-				y1 = y2;
-				y2 = t;
-			}
 
-			// Get Bresenhaming...
-			float dx = x2 - x1;
-			float dy = y2 - y1;
-			float err = 0.0;
-			float derr = ABS(dy / dx);
-
-			for ( int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x-- ) {
-				if(x == obj_x && y == obj_y) collided = 1;
-				err += derr;
-				while ( err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2) ) {
-					if(x == obj_x && y == obj_y) collided = 1;
-					y += (dy > 0) - (dy < 0);
-					err -= 1.0;
-				}
+		for(int n = 0; n < (GRID_ROWS - GRID_TOP) * GRID_COLS; n++) {
+			steps++;
+			if(grid_area_clear(r, c, cols, rows)) {
+				found = 1;
+				break;
+			}
+			if(++c == GRID_COLS) {
+				c = 0;
+				if(++r == GRID_ROWS) r = GRID_TOP;
 			}
 		}
 	}
-	return collided;
+
+	if(found) {
+		// Jitter inside the reserved cells
+		obj->pos.x = TO_REAL(c * GRID_CELL + rand() % (cols * GRID_CELL - w + 1));
+		obj->pos.y = TO_REAL(r * GRID_CELL + rand() % (rows * GRID_CELL - h + 1));
+	}
+
+	uint16_t elapsed = TCNT1 - start;
+	if(elapsed > spawn_latency_max) spawn_latency_max = elapsed;
+	if(steps > spawn_steps_max) spawn_steps_max = steps;
+	return found;
 }
 
-Coord make_random_coord() {
-    Coord result;
-	result.x = rand_range(0, LCD_X);
-	result.y = rand_range(GAME_CEILING, LCD_Y);
-    return result;
+// Any wall in column x, rows y to y+h-1. Reads one mask byte per bank.
+int wall_column_hits(int x, int y, int h) {
+	if (x < 0 || x >= LCD_X) return 0;
+	if (y < 0) { h += y; y = 0; }
+	if (y + h > LCD_Y) h = LCD_Y - y;
+
+	while (h > 0) {
+		int bit = y & 7;
+		int n = (8 - bit < h) ? 8 - bit : h; // rows in this bank
+		if (wall_mask[(y >> 3) * LCD_X + x] & (uint8_t)(ROW_MASK(n) << bit)) return 1;
+		y += n;
+		h -= n;
+	}
+	return 0;
 }
 
-void find_clear(Object* obj) {
-	int found = 1;
-
-	while(found) {
-		obj->pos = make_random_coord();
-		int newX = round(obj->pos.x);
-		int newY = round(obj->pos.y);
-
-		// Make sure coords are in game bounds
-		while(newX > LCD_X-obj->w) newX--;
-		while(newY > LCD_Y-obj->h) newY--;		
-
-		found=0;
-
-		if(!found) {
-			for(int x = newX; x < newX + obj->w; x++) {
-				for(int y = newY; y < newY + obj->h; y++) {
-
-					//Find cheese
-					if(!found) {
-						for (int i=0; i < MAX_CHEESE; i++ ) {
-							if(game.cheese[i].active == 1) {
-								int obj2x = round(game.cheese[i].pos.x);
-								int obj2y = round(game.cheese[i].pos.y);
-								if((x == obj2x) && (y == obj2y)) {
-									found=1;
-								} 
-							}
-						} 
-					}
-
-					// // Find traps
-					if(!found) {
-						for (int i=0; i < MAX_TRAPS; i++ ) {
-							if(game.traps[i].active == 1) {
-								int obj2x = round(game.traps[i].pos.x);
-								int obj2y = round(game.traps[i].pos.y);
-								if((x == obj2x) && (y == obj2y)) {
-									found=1;
-								} 
-							}
-						} 
-					}
-
-					// Find Tom
-					if(!found) {
-						if(x == round(tom.data.obj.pos.x) && y == round(tom.data.obj.pos.y)) {
-							found=1;
-						} 
-					}
-
-					// Find Jerry
-					if(!found) {
-						if(x == round(jerry.data.obj.pos.x) && y == round(jerry.data.obj.pos.y)) {
-							found=1;
-						} 
-					}
-
-					// Find Door
-					if(!found) {
-						if(game.door.active == 1) {
-							if(x == round(game.door.pos.x) && y == round(game.door.pos.y)) {
-								found=1;
-							} 
-						}
-					}
-
-					// Find Walls
-					if(!found)
-					for (int i=0; i < MAX_WALLS; i++ ) {
-						if(check_wall(x, y)) {
-							found=1;
-						} 
-					} 
-				} 
-			}
-		}
+// Any wall in row y, columns x to x+w-1
+int wall_row_hits(int x, int y, int w) {
+	if (y < 0 || y >= LCD_Y) return 0;
+	if (x < 0) { w += x; x = 0; }
+	if (x + w > LCD_X) w = LCD_X - x;
+
+	uint8_t* row = &wall_mask[(y >> 3) * LCD_X + x];
+	uint8_t bit = 1 << (y & 7);
+	for (int i = 0; i < w; i++) {
+		if (row[i] & bit) return 1;
 	}
+	return 0;
+}
+
+/*
+**	Which edges of a w x h box at (x, y) touch a wall.
+**  Returns WALL_LEFT | WALL_RIGHT | WALL_TOP | WALL_BOTTOM bits.
+*/
+uint8_t wall_sides(int x, int y, int w, int h) {
+	uint8_t sides = 0;
+	if (wall_column_hits(x, y, h)) sides |= WALL_LEFT;
+	if (wall_column_hits(x + w - 1, y, h)) sides |= WALL_RIGHT;
+	if (wall_row_hits(x, y, w)) sides |= WALL_TOP;
+	if (wall_row_hits(x, y + h - 1, w)) sides |= WALL_BOTTOM;
+	return sides;
 }
 
 int collide_bitmap_wall(int x1, int y1, int x2, int y2, collide_dir dir) {
-	int collided = 0;
-	if(dir == BT) {
-		for(int i = y1; i < y2; i++) {
-			if(check_wall(x1, i)) collided = 1;
-		}
+	if(dir == BT) return wall_column_hits(x1, y1, y2 - y1);
+	return wall_row_hits(x1, y1, x2 - x1);
+}
 
-	} else {
-		for(int i = x1; i < x2; i++) {
-			if(check_wall(i, y1)) collided = 1;
+// -------------------------------------------------
+// Dirty regions.
+// The frame is still cleared and redrawn every time, but only the bank
+// columns drawn this frame or last frame are sent to the LCD. Anything
+// drawn last frame and not redrawn got wiped by clear_screen.
+// -------------------------------------------------
+
+// Mark a box as changed
+void dirty_mark(int x, int y, int w, int h) {
+	if (x < 0) { w += x; x = 0; }
+	if (y < 0) { h += y; y = 0; }
+	if (x + w > LCD_X) w = LCD_X - x;
+	if (y + h > LCD_Y) h = LCD_Y - y;
+	if (w <= 0 || h <= 0) return;
+
+	for (int bank = y >> 3; bank <= (y + h - 1) >> 3; bank++) {
+		if (x < dirty_lo[bank]) dirty_lo[bank] = x;
+		if (x + w - 1 > dirty_hi[bank]) dirty_hi[bank] = x + w - 1;
+	}
+}
+
+// Mark the bounding box of a line
+void dirty_mark_line(int line[]) {
+	int x = (line[0] < line[2]) ? line[0] : line[2];
+	int y = (line[1] < line[3]) ? line[1] : line[3];
+	dirty_mark(x, y, ABS(line[2] - line[0]) + 1, ABS(line[3] - line[1]) + 1);
+}
+
+// Resend the whole screen next frame
+void dirty_mark_all() {
+	dirty_mark(0, 0, LCD_X, LCD_Y);
+	for (int i = 0; i < MAX_WALLS; i++) drawn_walls[i][0] = 0;
+	drawn_status[0] = '\0';
+}
+
+// Clock one bit out to the LCD, MSB first. Every step is a single
+// sbi/cbi/sbrs since PORTB and PORTF are in the low I/O space.
+#define LCD_SEND_BIT(byte, bit) do { \
+	if (BIT_IS_SET(byte, bit)) SET_BIT(PORTB, DINPIN); \
+	else CLEAR_BIT(PORTB, DINPIN); \
+	SET_BIT(PORTF, SCKPIN); \
+	CLEAR_BIT(PORTF, SCKPIN); \
+} while (0)
+
+/*
+**  Stream a run of display data bytes in one transfer. Chip select and
+**  D/C are set once for the whole run instead of per byte as with
+**  lcd_write(), and the bit loop is unrolled.
+*/
+void lcd_stream(const uint8_t* data, uint8_t count) {
+#ifdef HOST
+	while (count--) LCD_DATA(*data++); // no pins to clock on the host
+#else
+	SET_BIT(PORTB, DCPIN); // data
+	CLEAR_BIT(PORTD, SCEPIN);
+	while (count--) {
+		uint8_t byte = *data++;
+		LCD_SEND_BIT(byte, 7);
+		LCD_SEND_BIT(byte, 6);
+		LCD_SEND_BIT(byte, 5);
+		LCD_SEND_BIT(byte, 4);
+		LCD_SEND_BIT(byte, 3);
+		LCD_SEND_BIT(byte, 2);
+		LCD_SEND_BIT(byte, 1);
+		LCD_SEND_BIT(byte, 0);
+	}
+	SET_BIT(PORTD, SCEPIN);
+#endif
+}
+
+/*
+**	Send the dirty columns of each bank to the LCD.
+**  Replaces show_screen() in the game loop.
+*/
+void show_dirty() {
+	for (int bank = 0; bank < LCD_BANKS; bank++) {
+		uint8_t lo = (dirty_lo[bank] < prev_dirty_lo[bank]) ? dirty_lo[bank] : prev_dirty_lo[bank];
+		uint8_t hi = (dirty_hi[bank] > prev_dirty_hi[bank]) ? dirty_hi[bank] : prev_dirty_hi[bank];
+
+		if (lo <= hi) {
+			LCD_CMD(lcd_set_x_addr, lo);
+			LCD_CMD(lcd_set_y_addr, bank);
+			lcd_stream(&screen_buffer[bank * LCD_X + lo], hi - lo + 1);
 		}
+
+		prev_dirty_lo[bank] = dirty_lo[bank];
+		prev_dirty_hi[bank] = dirty_hi[bank];
+		dirty_lo[bank] = LCD_X;
+		dirty_hi[bank] = 0;
 	}
-	return collided;
 }
 
 void draw_walls() {
 	for(int i = 0; i < MAX_WALLS; i++) {
-		if (game.walls[i].data.obj.active == 1) {
+		// Only walls that moved, appeared or vanished need sending
+		if (drawn_walls[i][0] != WALL_LIVE(i) || 
+			memcmp(&drawn_walls[i][1], game.walls[i].line, sizeof(game.walls[i].line)) != 0) {
+			if (drawn_walls[i][0] == 1) dirty_mark_line(&drawn_walls[i][1]);
+			if (WALL_LIVE(i)) dirty_mark_line(game.walls[i].line);
+			drawn_walls[i][0] = WALL_LIVE(i);
+			memcpy(&drawn_walls[i][1], game.walls[i].line, sizeof(game.walls[i].line));
+		}
+
+		if (WALL_LIVE(i)) {
 			draw_line(game.walls[i].line[0], game.walls[i].line[1], game.walls[i].line[2], game.walls[i].line[3], BG_COLOUR);
 		}
 	}
 }
 
+// 1 << n for the blitter, so AVR can shift with one MUL instead of a loop
+const uint8_t shift_mul[8] PROGMEM = { 1, 2, 4, 8, 16, 32, 64, 128 };
+
+/*
+**  Blit a column-major flash bitmap (at most 8 rows) into the screen buffer.
+**  Each column is shifted to its bank offset as a 16 bit value, then
+**  ORed or cleared into the two banks it straddles. Clips at the edges.
+*/
+void blit_bitmap(int x, int y, int w, int h, const uint8_t bitmap[], colour_t colour) {
+	if (y <= -8 || y >= LCD_Y || h <= 0) return;
+
+	uint8_t rows = ROW_MASK(h);
+	int bank = (y < 0) ? -1 : y >> 3;
+	uint8_t mul = pgm_read_byte(&shift_mul[y & 7]);
+	int top = bank * LCD_X; // offsets of the two banks
+	int bottom = top + LCD_X;
+
+	for (int i = 0; i < w; i++) {
+		int col = x + i;
+		if (col < 0) continue;
+		if (col >= LCD_X) break;
+
+		uint16_t shifted = (uint8_t)(pgm_read_byte(&bitmap[i]) & rows) * mul;
+		uint8_t lo = shifted;
+		uint8_t hi = shifted >> 8;
+
+		if (colour == FG_COLOUR) {
+			if (bank >= 0 && lo) screen_buffer[top + col] |= lo;
+			if (bank + 1 < LCD_BANKS && hi) screen_buffer[bottom + col] |= hi;
+		} else {
+			if (bank >= 0 && lo) screen_buffer[top + col] &= ~lo;
+			if (bank + 1 < LCD_BANKS && hi) screen_buffer[bottom + col] &= ~hi;
+		}
+	}
+}
+
 /*
 **  Draw a bitmap directly to LCD.
 **  (Notice: y-coordinate.)
 */
-void draw_data(Object *obj, uint8_t bitmap[]) {
-
-    // Visit each column of output bitmap
-    for (int i = 0; i < obj->w; i++) {
-        // Visit each row of output bitmap
-        for (int j = 0; j < obj->h; j++) {
-			if (BIT_VALUE(bitmap[i], j) == 1) 
-				draw_pixel(round(obj->pos.x+i), round(obj->pos.y+j),FG_COLOUR);
-        }
-    }
-	
+void draw_data(Object *obj) {
+	dirty_mark(REAL_ROUND(obj->pos.x), REAL_ROUND(obj->pos.y), OBJ_W(obj), OBJ_H(obj));
+	blit_bitmap(REAL_ROUND(obj->pos.x), REAL_ROUND(obj->pos.y), OBJ_W(obj), OBJ_H(obj), OBJ_BITMAP(obj), FG_COLOUR);
 }
 
 /*
 ** Remove 1 entity from the screen (1 bank size)
 */
-void erase_entity(Mobile mob, uint8_t bitmap[]) {
-
-    // Visit each column of output bitmap
-    for (int i = 0; i < mob.obj.w; i++) {
-        // Visit each row of output bitmap
-        for (int j = 0; j < mob.obj.h; j++) {
-
-			if (BIT_VALUE(bitmap[i], j) == 1) 
-				draw_pixel(mob.obj.pos.x+i, mob.obj.pos.y+j,BG_COLOUR);
-        }
-    }	
+void erase_entity(Mobile* mob) {
+	Object* obj = &mob->obj;
+	dirty_mark(REAL_INT(obj->pos.x), REAL_INT(obj->pos.y), OBJ_W(obj), OBJ_H(obj));
+	blit_bitmap(REAL_INT(obj->pos.x), REAL_INT(obj->pos.y), OBJ_W(obj), OBJ_H(obj), OBJ_BITMAP(obj), BG_COLOUR);
 }
 
 void create_firework() {
 	if (game.cheese_count >= 3) {
-		for (int i = 0; i < MAX_FIREWORKS; i++) {
-			if (game.fireworks[i].obj.active == 0) {
-				game.fireworks[i].obj.active = 1;
-				game.fireworks[i].obj.pos.x = jerry.data.obj.pos.x + jerry.data.obj.w/2;
-				game.fireworks[i].obj.pos.y = jerry.data.obj.pos.y + jerry.data.obj.h/2;
-				game.fireworks[i].speed=1;
-				game.fireworks[i].obj.w = TN_OBJ_WIDTH;
-				game.fireworks[i].obj.h = TN_OBJ_HEIGHT;
-				game.fireworks[i].obj.bitmap=firework_direct;
-				return;
-			}
+		int i = pool_alloc(&game.firework_pool);
+		if (i >= 0) {
+			game.fireworks[i].pos.x = jerry.data.obj.pos.x + TO_REAL(OBJ_W(&jerry.data.obj)/2);
+			game.fireworks[i].pos.y = jerry.data.obj.pos.y + TO_REAL(OBJ_H(&jerry.data.obj)/2);
+			game.fireworks[i].sprite = SPR_FIREWORK;
 		}	
 	}
 }
 
 /*
-**	Setup walls
+**  Put a room's walls and start positions in play. mask is a flash copy
+**  of the room's wall mask, or NULL to raster it from the walls.
+*/
+void room_install(const Room* room, const uint8_t* mask) {
+	game.wall_live = 0;
+	for (uint8_t i = 0; i < room->wall_count; i++) {
+		memcpy(game.walls[i].line, room->walls[i], sizeof(game.walls[i].line));
+		wall_init_step(&game.walls[i]);
+		game.wall_live |= 1 << i;
+	}
+	if (room->has_tom) {
+		tom.data.origin = room->tom;
+		tom.data.obj.pos = room->tom; // Set Tom's original position
+	}
+	if (room->has_jerry) {
+		jerry.data.origin = room->jerry;
+		jerry.data.obj.pos = room->jerry;
+	}
+	if (mask) {
+		memcpy_P(wall_mask, mask, LCD_BUFFER_SIZE);
+		grid_update_walls();
+	} else {
+		update_wall_mask();
+	}
+}
+
+// Find room n of a flash pack, NULL if the pack is shorter
+const uint8_t* room_find(const uint8_t* pack, uint8_t n) {
+	while (pgm_read_byte(pack) == ROOM_VERSION) {
+		if (n-- == 0) return pack;
+		uint8_t flags = pgm_read_byte(pack + 1);
+		pack += ROOM_HEADER + pgm_read_byte(pack + 2) * 4;
+		if (flags & ROOM_HAS_MASK) pack += LCD_BUFFER_SIZE;
+	}
+	return NULL;
+}
+
+// Load room n of the level pack, 0 if there is no such room
+int room_unpack(uint8_t n) {
+	const uint8_t* packed = room_find(level_pack, n);
+	if (!packed) return 0;
+
+	uint8_t bytes[ROOM_HEADER + MAX_WALLS * 4];
+	memcpy_P(bytes, packed, ROOM_HEADER);
+	uint8_t walls = bytes[2];
+	if (walls > MAX_WALLS) return 0;
+	memcpy_P(bytes + ROOM_HEADER, packed + ROOM_HEADER, walls * 4);
+
+	Room room;
+	room.wall_count = walls;
+	for (uint8_t i = 0; i < walls * 4; i++) room.walls[i / 4][i % 4] = (int8_t)bytes[ROOM_HEADER + i];
+	room.has_tom = room.has_jerry = 1;
+	room.tom.x = TO_REAL(bytes[3]);
+	room.tom.y = TO_REAL(bytes[4]);
+	room.jerry.x = TO_REAL(bytes[5]);
+	room.jerry.y = TO_REAL(bytes[6]);
+	room_install(&room, (bytes[1] & ROOM_HAS_MASK) ? packed + ROOM_HEADER + walls * 4 : NULL);
+	return 1;
+}
+
+/*
+**	Setup walls (and start positions) from the first pack room. The
+**  others are played with an "R n" record at level 2.
 */
 void setup_walls_1() {
-	game.walls[0].data.obj.active = 1;
-	game.walls[0].line[0] = 18;
-	game.walls[0].line[1] = 15;
-	game.walls[0].line[2] = 13;
-	game.walls[0].line[3] = 25;
-	game.walls[0].data.obj.pos.x = 	game.walls[0].line[2] - game.walls[0].line[0];
-	game.walls[0].data.obj.pos.y = 	game.walls[0].line[3] - game.walls[0].line[1];
-
-	game.walls[1].data.obj.active = 1;
-	game.walls[1].line[0] = 25;
-	game.walls[1].line[1] = 35;
-	game.walls[1].line[2] = 25;
-	game.walls[1].line[3] = 45;
-	game.walls[1].data.obj.pos.x = 	game.walls[1].line[2] - game.walls[1].line[0];
-	game.walls[1].data.obj.pos.y = 	game.walls[1].line[3] - game.walls[1].line[1];	
-
-	game.walls[2].data.obj.active = 1;
-	game.walls[2].line[0] = 45;
-	game.walls[2].line[1] = 10;
-	game.walls[2].line[2] = 60;
-	game.walls[2].line[3] = 10;
-	game.walls[2].data.obj.pos.x = 	game.walls[2].line[2] - game.walls[2].line[0];
-	game.walls[2].data.obj.pos.y = 	game.walls[2].line[3] - game.walls[2].line[1];	
-
-	game.walls[3].data.obj.active = 1;
-	game.walls[3].line[0] = 58;
-	game.walls[3].line[1] = 25;
-	game.walls[3].line[2] = 72;
-	game.walls[3].line[3] = 30;
-	game.walls[3].data.obj.pos.x = 	game.walls[3].line[2] - game.walls[3].line[0];
-	game.walls[3].data.obj.pos.y = 	game.walls[3].line[3] - game.walls[3].line[1];	
+	room_unpack(0);
 }
 
 /*
 **	Define Tom 
 */
 void setup_tom_1() {
-	tom.data.origin.x = LCD_X - 6;
-	tom.data.origin.y = LCD_Y - 9;
+	tom.data.origin.x = TO_REAL(LCD_X - 6);
+	tom.data.origin.y = TO_REAL(LCD_Y - 9);
 	tom.data.obj.pos = tom.data.origin;
-	tom.data.speed = TOM_SPEED;
+	tom.data.speed = FLOAT_TO_REAL(TOM_SPEED);
 	tom.lives = 5;
-	tom.data.obj.w = MAX_CHAR_WIDTH;
-	tom.data.obj.h = MAX_CHAR_HEIGHT;
-	tom.data.obj.bitmap = tom_direct;
+	tom.data.obj.sprite = SPR_TOM;
 	rand_direction(&tom.data, 1, 1);
 
 }
@@ -796,168 +1529,281 @@ void setup_tom_1() {
 **	Define Jerry 
 */
 void setup_jerry_1() {
-	jerry.data.origin.x = 0;
-	jerry.data.origin.y = 10;
+	jerry.data.origin.x = TO_REAL(0);
+	jerry.data.origin.y = TO_REAL(10);
 	jerry.data.obj.pos = jerry.data.origin;
-	jerry.data.speed = JERRY_SPEED;
-	jerry.data.d.x = 1;
-	jerry.data.d.y = 1;
+	jerry.data.speed = TO_REAL(JERRY_SPEED);
+	jerry.data.d.x = TO_REAL(1);
+	jerry.data.d.y = TO_REAL(1);
 	jerry.lives = 5;
 	jerry.score = 0;
-	jerry.data.obj.w = MAX_CHAR_WIDTH;
-	jerry.data.obj.h = MAX_CHAR_HEIGHT;
-	jerry.data.obj.bitmap = jerry_direct;
+	jerry.data.obj.sprite = SPR_JERRY;
     
 }
 
 void reset_game_vars() {
 	game.level=1;
-	game.cheese_timer = 0;
-	game.trap_timer = 0;
-	game.milk_timer = 0;
-	game.super_timer = 0;
+	wheel_reset(); // the clock restarts with the game
+	wheel_schedule(EV_CHEESE, CHEESE_MS);
+	wheel_schedule(EV_TRAP, TRAP_MS);
+	wheel_schedule(EV_MILK, MILK_MS);
 	game.cheese_count = 0;
 	game.cheese_count_level = 0;
 	game.super_mode=0;
-	time_min = 0;
 }
 
 void reset_objects() {
 	// cheese
-	for(int i=0;i<MAX_CHEESE;i++) game.cheese[i].active = 0;
+	pool_init(&game.cheese_pool, game.cheese_free, MAX_CHEESE);
 
 	// traps
-	for(int i=0;i<MAX_TRAPS;i++) game.traps[i].active=0;
+	pool_init(&game.trap_pool, game.trap_free, MAX_TRAPS);
 	
 	// fireworks
-	for(int i=0;i<MAX_FIREWORKS;i++) game.fireworks[i].obj.active=0;	
+	pool_init(&game.firework_pool, game.firework_free, MAX_FIREWORKS);
 
 	// door
-	game.door.active=0;
+	game.door_active=0;
 
 	// milk
-	game.milk.active=0;
+	game.milk_active=0;
 
 	// Level cheese count
 	game.cheese_count_level = 0;
+
+	grid_reset_objects();
 }
 
 void reset_game() {
 	if(game_state==GAMEOVER || game_state == WELCOME) {
+		// Back to level 1: drop any room still streaming in for level 2
+		room_state = ROOM_IDLE;
+		memset(&room_stage, 0, sizeof(room_stage));
 		setup_tom_1();
 		setup_jerry_1();
 		setup_walls_1();
-		reset_game_vars();
 		reset_timer3();
+		now_ms = 0; // the rest of this frame runs on the new clock
+		reset_game_vars();
 		game_state=RUNNING;	
 	}
 	reset_objects();
+	dirty_mark_all();
 	fade_in();
 }
 
 
+/*
+**  Start streaming a room in over USB. Never blocks: room_poll() picks
+**  up the bytes that have arrived each frame, and the current walls
+**  stay in play until the new room is complete.
+*/
 void load_room(void){
-
-	for (int i = 0; i < MAX_WALLS; i++) {
-		game.walls[i].data.obj.active = 0;
+	if (!room_usb_started) {
+		usb_init();
+		room_usb_started = 1;
 	}
-	draw_string(10, 10, "Connect USB...", FG_COLOUR);
-	show_screen();
+	memset(&room_stage, 0, sizeof(room_stage));
+	room_state = ROOM_CONNECT;
+}
 
-	// Setup USB
-	usb_init();
-	while ( !usb_configured() || !usb_serial_get_control()) {
-	}	
-	clear_screen();
-	draw_string(10, 10, "USB connected", FG_COLOUR);
-	show_screen();
-	_delay_ms(2000);
+// Swap the staged room in, all at once between frames
+void room_apply() {
+	room_install(&room_stage, NULL);
+	reset_objects(); // respawn against the new walls
+	dirty_mark_all();
+}
 
-	if (usb_serial_available()){
-		char tx_buffer[32];
+// A record's line ended; check it and add it to the staged room
+void room_end_record() {
+	uint8_t fields = (room_record == 'W') ? 4 : (room_record == 'E') ? 0 : (room_record == 'R') ? 1 : 2;
+	if (room_field != fields) {
+		room_errors++;
+		return;
+	}
 
-		int c = 0;
-		
-		while (c != -1) {
-			c = usb_serial_getchar(); //read usb port
-
-			if(c =='T'){ //
-				usb_serial_read_string(tx_buffer);
-				usb_serial_send( tx_buffer );
-				sscanf( tx_buffer, "%f %f", &tom.data.obj.pos.x, &tom.data.obj.pos.y);
-				tom.data.origin = tom.data.obj.pos; // Set Tom's original position
-			}
+	if (room_record == 'W') {
+		int* w = room_ints;
+		if (room_stage.wall_count >= MAX_WALLS || w[0] < -LCD_X || w[0] > 2 * LCD_X || w[2] < -LCD_X || w[2] > 2 * LCD_X
+			|| w[1] < -LCD_Y || w[1] > 2 * LCD_Y || w[3] < -LCD_Y || w[3] > 2 * LCD_Y) {
+			room_errors++; // too many walls, or a line nowhere near the screen
+			return;
+		}
+		memcpy(room_stage.walls[room_stage.wall_count++], room_ints, sizeof(room_stage.walls[0]));
+	} else if (room_record == 'E') {
+		room_apply();
+		room_state = ROOM_IDLE;
+	} else if (room_record == 'R') { // play a pack room instead
+		if (room_ints[0] < 0 || room_ints[0] > 255 || !room_unpack(room_ints[0])) {
+			room_errors++;
+			return;
+		}
+		reset_objects();
+		dirty_mark_all();
+		room_state = ROOM_IDLE;
+	} else {
+		if (room_ints[0] < 0 || room_ints[0] > LCD_X - MAX_CHAR_WIDTH || room_ints[1] < GAME_CEILING || room_ints[1] > LCD_Y - MAX_CHAR_HEIGHT) {
+			room_errors++;
+			return;
+		}
+		Coord pos = { room_reals[0], room_reals[1] };
+		if (room_record == 'T') {
+			room_stage.tom = pos;
+			room_stage.has_tom = 1;
+		} else {
+			room_stage.jerry = pos;
+			room_stage.has_jerry = 1;
+		}
+	}
+}
 
-			if(c =='J'){ //
-				usb_serial_read_string(tx_buffer);
-				usb_serial_send( tx_buffer );
-				sscanf( tx_buffer, "%f %f", &jerry.data.obj.pos.x, &jerry.data.obj.pos.y);		
-				jerry.data.origin = jerry.data.obj.pos;
-			}
+void room_clear_number() {
+	room_digits = 0;
+	room_neg = 0;
+	room_point = 0;
+	room_whole = 0;
+	room_frac = 0;
+	room_frac_div = 1;
+}
 
-			//things to check here. Variable wall_num should be less than MAX_WALLS 
-			if(c =='W'){
-				char walls[64];
-				usb_serial_read_string(walls);
-				usb_serial_send( walls ); 
-				if(wall_num > MAX_WALLS) {
-					sprintf(tx_buffer,"Error: Too many walls");
-					usb_serial_send( tx_buffer );
-				} else {
-					sscanf( walls, "%d %d %d %d", &game.walls[wall_num].line[0], &game.walls[wall_num].line[1], &game.walls[wall_num].line[2], &game.walls[wall_num].line[3]);
-					game.walls[wall_num].data.obj.active = 1;
-					wall_num++;				
-				}
+// A field's number ended
+void room_end_field() {
+	if (room_digits == 0) return; // just separators
+	if (room_field < 4) {
+		room_ints[room_field] = room_neg ? -room_whole : room_whole;
+		if (room_field < 2) {
+			real r = TO_REAL(room_whole) + (real)((int32_t)room_frac * TO_REAL(1) / room_frac_div);
+			room_reals[room_field] = room_neg ? -r : r;
+		}
+	}
+	room_field++;
+	room_clear_number();
+}
+
+// Feed one byte to the room parser
+void room_parse(char c) {
+	if (room_state == ROOM_RECORD) {
+		if (c == 'T' || c == 'J' || c == 'W' || c == 'E' || c == 'R') {
+			room_record = c;
+			room_field = 0;
+			room_clear_number();
+			room_state = ROOM_FIELDS;
+		} else if (c != '\n' && c != '\r' && c != ' ') {
+			room_errors++;
+			room_state = ROOM_SKIP;
+		}
+		return;
+	}
 
+	if (c == '\n' || c == '\r') {
+		if (room_state == ROOM_FIELDS) {
+			room_end_field();
+			room_state = ROOM_RECORD;
+			room_end_record(); // may finish the room
+		} else {
+			room_state = ROOM_RECORD;
+		}
+		return;
+	}
+	if (room_state == ROOM_SKIP) return;
+
+	if (c >= '0' && c <= '9') {
+		if (room_point) {
+			if (room_frac_div < 1000) {
+				room_frac = room_frac * 10 + (c - '0');
+				room_frac_div *= 10;
 			}
+		} else if (room_whole < 1000) {
+			room_whole = room_whole * 10 + (c - '0');
 		}
-    }
+		if (room_digits < 255) room_digits++;
+	} else if (c == '.') {
+		room_point = 1;
+	} else if (c == '-' && room_digits == 0) {
+		room_neg = 1;
+	} else if (c == ' ' || c == '\t' || c == ',') {
+		room_end_field();
+	} else {
+		room_errors++;
+		room_state = ROOM_SKIP;
+	}
+}
+
+/*
+**  Advance the room loader with whatever USB bytes have arrived, at most
+**  ROOM_BYTES_PER_FRAME. A room ends at an "E" record, or once the link
+**  has been quiet for ROOM_IDLE_MS after some records.
+*/
+void room_poll() {
+	if (room_state == ROOM_IDLE) return;
+	if (room_state == ROOM_CONNECT) {
+		if (!usb_configured() || !usb_serial_get_control()) return;
+		room_state = ROOM_RECORD;
+		room_last_ms = now_ms;
+	}
+
+	for (uint8_t n = 0; n < ROOM_BYTES_PER_FRAME && room_state != ROOM_IDLE; n++) {
+		int16_t c = usb_serial_getchar();
+		if (c < 0) break;
+		room_last_ms = now_ms;
+		room_parse(c);
+	}
+
+	if (room_state == ROOM_RECORD && now_ms - room_last_ms >= ROOM_IDLE_MS
+		&& (room_stage.wall_count || room_stage.has_tom || room_stage.has_jerry)) {
+		room_apply();
+		room_state = ROOM_IDLE;
+	}
 }
 
 void process_input(void) {
-	static uint8_t prev_j_up = 0;
-	static uint8_t prev_j_down = 0;
-	static uint8_t prev_j_left = 0;
-	static uint8_t prev_j_right = 0;
-	static uint8_t prev_b_left = 0;
-	static uint8_t prev_b_right = 0;
-	static uint8_t prev_j_center = 0;
+	// Presses since last frame. Buttons act once per press; the joystick
+	// also moves while held, and a tap shorter than a frame still counts.
+	uint8_t pressed = 0;
+	InputEvent ev;
+	while (input_pop(&ev)) {
+		if (!ev.pressed) continue;
+		pressed |= 1 << ev.input;
+		if (!input_waiting) input_stamp = ev.ms;
+		input_waiting = 1;
+	}
+	uint8_t active = pressed | input_held;
 
 	int c = 0;
 
-	if(game.level == 2) {
+	if(game.level == 2 && room_state == ROOM_IDLE) { // the room loader owns USB until done
 		if (usb_serial_available()){	
 			c = usb_serial_getchar(); // read usb port
 			usb_serial_flush_input(); // Kind of like a serial debouncer
 		}
 	}
 
-	float jerryX = jerry.data.obj.pos.x;
-	float jerryY = jerry.data.obj.pos.y;
-	int jerryW = jerry.data.obj.w;
-	int jerryH = jerry.data.obj.h;
+	real jerryX = jerry.data.obj.pos.x;
+	real jerryY = jerry.data.obj.pos.y;
+	int jerryW = OBJ_W(&jerry.data.obj);
+	int jerryH = OBJ_H(&jerry.data.obj);
 
 	int newX, newY;
 	int modX1, modX2, modY1, modY2;
 	collide_dir collideDir;
 
 	// direction vectors per joystick direction
-	const Coord dirs[] = { {-1, 0}, {0, -1}, {1, 0}, {0, 1} }; // L, U, R, D
+	const Coord dirs[] = { {TO_REAL(-1), 0}, {0, TO_REAL(-1)}, {TO_REAL(1), 0}, {0, TO_REAL(1)} }; // L, U, R, D
 	int dir = -1;
 
-	if (sw_j_up != prev_j_up || c == 'w' || c == 'W') 
+	if (BIT_IS_SET(active, IN_J_UP) || c == 'w' || c == 'W') 
 		dir = 1;
-	else if (sw_j_down != prev_j_down || c == 's' || c == 'S') 
+	else if (BIT_IS_SET(active, IN_J_DOWN) || c == 's' || c == 'S') 
 		dir = 3;
-	else if (sw_j_left != prev_j_left || c == 'a' || c == 'A') 
+	else if (BIT_IS_SET(active, IN_J_LEFT) || c == 'a' || c == 'A') 
 		dir = 0;
-	else if (sw_j_right != prev_j_right || c == 'd' || c == 'D') 
+	else if (BIT_IS_SET(active, IN_J_RIGHT) || c == 'd' || c == 'D') 
 		dir = 2;
 
 	if (dir > -1)
 	{
-		newX = round(jerryX + dirs[dir].x);
-		newY = round(jerryY + dirs[dir].y);
+		newX = REAL_ROUND(jerryX + dirs[dir].x);
+		newY = REAL_ROUND(jerryY + dirs[dir].y);
 		modX1 = 0;
 		modX2 = 0;
 		modY1 = 0;
@@ -990,28 +1836,27 @@ void process_input(void) {
 			
 			if (collideDir == LR)
 			{
-				jerry.data.obj.pos.y += scale_velocity(dirs[dir].y * jerry.data.speed);
-				if (jerry.data.obj.pos.y > LCD_Y - MAX_CHAR_HEIGHT) jerry.data.obj.pos.y = LCD_Y - MAX_CHAR_HEIGHT;
-				if (jerry.data.obj.pos.y < GAME_CEILING) jerry.data.obj.pos.y = GAME_CEILING;
+				jerry.data.obj.pos.y += scale_velocity(REAL_MUL(dirs[dir].y, jerry.data.speed));
+				if (jerry.data.obj.pos.y > TO_REAL(LCD_Y - MAX_CHAR_HEIGHT)) jerry.data.obj.pos.y = TO_REAL(LCD_Y - MAX_CHAR_HEIGHT);
+				if (jerry.data.obj.pos.y < TO_REAL(GAME_CEILING)) jerry.data.obj.pos.y = TO_REAL(GAME_CEILING);
 			}
 			else if (collideDir == BT)
 			{
-				jerry.data.obj.pos.x += scale_velocity(dirs[dir].x * jerry.data.speed);
+				jerry.data.obj.pos.x += scale_velocity(REAL_MUL(dirs[dir].x, jerry.data.speed));
 				if (jerry.data.obj.pos.x < 0) jerry.data.obj.pos.x = 0;
-				if (jerry.data.obj.pos.x > LCD_X - (MAX_CHAR_WIDTH)) jerry.data.obj.pos.x = LCD_X-(MAX_CHAR_WIDTH);
+				if (jerry.data.obj.pos.x > TO_REAL(LCD_X - (MAX_CHAR_WIDTH))) jerry.data.obj.pos.x = TO_REAL(LCD_X-(MAX_CHAR_WIDTH));
 			}
 		}
 	}
 
 
 	// JOYSTICK CENTER
-	if (sw_j_center != prev_j_center || c == 'f') {
+	if (BIT_IS_SET(pressed, IN_J_CENTER) || c == 'f') {
 		create_firework();
-		_delay_ms(100);
 	}
 
 	// LEFT BUTTON
-	if (sw_b_left != prev_b_left || c == 'l') {
+	if (BIT_IS_SET(pressed, IN_B_LEFT) || c == 'l') {
 		//turnOnLed0();
 		if(game.level == 2) {
 			game_state = GAMEOVER;
@@ -1026,7 +1871,7 @@ void process_input(void) {
 	}
 
 	// RIGHT BUTTON
-	if (sw_b_right != prev_b_right || c == 'p') {
+	if (BIT_IS_SET(pressed, IN_B_RIGHT) || c == 'p') {
 		//turnOffLed0();
 		if(game_state == RUNNING) {
 			game_state = PAUSE;
@@ -1040,72 +1885,32 @@ void process_input(void) {
 }
 
 
-/*
-**  Convert bitmap into vertical slices for direct drawing.
-*/
-void setup_bitmap(int cols, int rows, uint8_t original[], uint8_t direct[]) {
-    // Visit each column of output bitmap
-    for (int i = 0; i < cols; i++) {
-        // Visit each row of output bitmap
-        for (int j = 0; j < rows; j++) {
-            // Flip about the major diagonal.
-            uint8_t bit_val = BIT_VALUE(original[j], cols-1-i);
-            WRITE_BIT(direct[i], j, bit_val);
-        }
-    }
-}
-
-
-/*
-**	Setup all bitmaps
-*/
-void setup_bitmaps() {
-	setup_bitmap(8,NUMELEMS(milk_original),milk_original,milk_direct);	
-	setup_bitmap(8,NUMELEMS(jerry_original),jerry_original,jerry_direct);	
-	setup_bitmap(8,NUMELEMS(cheese_original),cheese_original,cheese_direct);	
-	setup_bitmap(8,NUMELEMS(tom_original),tom_original,tom_direct);	
-	setup_bitmap(8,NUMELEMS(trap_original),trap_original,trap_direct);	
-	setup_bitmap(8,NUMELEMS(door_original),door_original,door_direct);
-	setup_bitmap(8,NUMELEMS(firework_original),firework_original,firework_direct);
-	setup_bitmap(8,NUMELEMS(super_original),super_original,super_direct);
-}
-
-
 /*
 **	Test only the overlapping part of the bitmaps
-**  Narrow phase collisions. This can be shortened a lot
-**  Written this way for readability
+**  Narrow phase collisions. Each overlapping column of b is shifted
+**  to line up with a, then the two column bytes are ANDed.
+**  Bitmaps are at most 8 rows high.
 */
 int collide_bitmaps(Object* a, Object* b) {
-
-	// Find overlapping pixel grid
-	int bNew = MIN((int)a->pos.y + a->h, (int)b->pos.y + b->h); // new bottom
-	int tNew = MAX((int)a->pos.y, (int)b->pos.y); // new top
-	int lNew = MAX((int)a->pos.x, (int)b->pos.x); // new left
-	int rNew = MIN((int)a->pos.x + a->w, (int)b->pos.x + b->w); // new right
-
-	// starting rows and columns in bitmap
-	int aRow = (int)tNew - (int)a->pos.y;
-	int aCol = (int)lNew - (int)a->pos.x;
-	int bRow = (int)tNew - (int)b->pos.y;
-	int bCol = (int)lNew - (int)b->pos.x;			
-
-	// Number of rows & cols in the overlapping grid
-	int numCols = (int)rNew - (int)lNew;
-	int numRows = (int)bNew - (int)tNew;
-
-	for(int rows = 0; rows < numRows; rows++) {
-		for (int cols = 0; cols < numCols; cols++) {
-			if (BIT_IS_SET(a->bitmap[aCol], aRow) && BIT_IS_SET(b->bitmap[bCol], bRow)) {
-				return 1; // Overlapping pixel found (collision)
-			}	
-			aCol++; // Increment bitmap cols based on
-			bCol++; // how far into the overlap grid we are
-		}
-		aRow++; // Increment bitmap rows based on
-		bRow++; // how far into the overlap grid we are
-		aCol -= numCols; // Reset cols on new row
-		bCol -= numCols;
+	int ax = REAL_INT(a->pos.x), ay = REAL_INT(a->pos.y);
+	int bx = REAL_INT(b->pos.x), by = REAL_INT(b->pos.y);
+	int dy = by - ay; // b's rows sit this far below a's
+
+	if (dy >= OBJ_H(a) || -dy >= OBJ_H(b)) return 0;
+
+	int lNew = (ax > bx) ? ax : bx; // new left
+	int rNew = (ax + OBJ_W(a) < bx + OBJ_W(b)) ? ax + OBJ_W(a) : bx + OBJ_W(b); // new right
+	uint8_t aMask = ROW_MASK(OBJ_H(a));
+	uint8_t bMask = ROW_MASK(OBJ_H(b));
+	const uint8_t* aBitmap = OBJ_BITMAP(a);
+	const uint8_t* bBitmap = OBJ_BITMAP(b);
+
+	for (int x = lNew; x < rNew; x++) {
+		uint8_t aCol = pgm_read_byte(&aBitmap[x - ax]) & aMask;
+		uint8_t bCol = pgm_read_byte(&bBitmap[x - bx]) & bMask;
+		if (dy >= 0) bCol <<= dy;
+		else aCol <<= -dy;
+		if (aCol & bCol) return 1; // Overlapping pixel found (collision)
 	}
 	return 0;
 }
@@ -1113,15 +1918,15 @@ int collide_bitmaps(Object* a, Object* b) {
 
 // Broad phase collision 
 int obj_collided(Object* a, Object* b) {
-	int aB = a->pos.y + a->h-1; // a - bottom edge
-	int aT = a->pos.y;		    // a - top edge
-	int aL = a->pos.x;		    // a - left edge
-	int aR = a->pos.x + a->w-1; // a - right edge
+	int aB = REAL_INT(a->pos.y) + OBJ_H(a)-1; // a - bottom edge
+	int aT = REAL_INT(a->pos.y);		    // a - top edge
+	int aL = REAL_INT(a->pos.x);		    // a - left edge
+	int aR = REAL_INT(a->pos.x) + OBJ_W(a)-1; // a - right edge
 
-	int bB = b->pos.y + b->h-1;
-	int bT = b->pos.y;
-	int bL = b->pos.x;
-	int bR = b->pos.x + b->w-1;
+	int bB = REAL_INT(b->pos.y) + OBJ_H(b)-1;
+	int bT = REAL_INT(b->pos.y);
+	int bL = REAL_INT(b->pos.x);
+	int bR = REAL_INT(b->pos.x) + OBJ_W(b)-1;
 
 	// Can't be collision
 	if (aB <= bT || aT > bB || aL > bR || aR < bL) return 0;
@@ -1135,20 +1940,97 @@ void reset_position(Mobile* mob) {
 
 void make_super() {
 	game.super_mode = 1;
-	jerry.data.obj.bitmap = super_direct;
-	jerry.data.obj.w = 6;
-	jerry.data.obj.h = 8;
-	game.super_timer = supertimer = get_current_time();
+	jerry.data.obj.sprite = SPR_SUPER;
+	supertimer = 0;
+	wheel_schedule(EV_SUPER, now_ms + SUPER_STEP_MS);
 }
 
 void clear_super() {
 	game.super_mode = 0;
-	jerry.data.obj.w = CHAR_WIDTH;
-	jerry.data.obj.h = CHAR_HEIGHT;
-	jerry.data.obj.bitmap = jerry_direct;
+	jerry.data.obj.sprite = SPR_JERRY;
+	wheel_cancel(EV_SUPER);
+}
+
+// -------------------------------------------------
+// Broad phase.
+// -------------------------------------------------
+
+Object* broad_object(uint8_t id) {
+	if (id < BROAD_TRAP0) return &game.cheese[id];
+	if (id < BROAD_DOOR) return &game.traps[id - BROAD_TRAP0];
+	if (id == BROAD_DOOR) return &game.door;
+	if (id == BROAD_MILK) return &game.milk;
+	return &game.fireworks[id - BROAD_FIREWORK0];
+}
+
+int broad_clamp(int v, int max) {
+	if (v < 0) return 0;
+	if (v > max) return max;
+	return v;
+}
+
+void broad_insert(uint8_t heads[], uint8_t id) {
+	Object* obj = broad_object(id);
+	int col = broad_clamp(REAL_INT(obj->pos.x) / BROAD_CELL, BROAD_COLS - 1);
+	int row = broad_clamp(REAL_INT(obj->pos.y) / BROAD_CELL, BROAD_ROWS - 1);
+	broad_next[id] = heads[row * BROAD_COLS + col];
+	heads[row * BROAD_COLS + col] = id;
+}
+
+int broad_live(uint8_t id) {
+	if (id < BROAD_TRAP0) return POOL_LIVE(game.cheese_pool, id);
+	if (id < BROAD_DOOR) return POOL_LIVE(game.trap_pool, id - BROAD_TRAP0);
+	if (id == BROAD_DOOR) return game.door_active;
+	if (id == BROAD_MILK) return game.milk_active;
+	return POOL_LIVE(game.firework_pool, id - BROAD_FIREWORK0);
+}
+
+// Relink every active object. Cost grows with live objects, not pool sizes.
+void broad_rebuild() {
+	uint32_t m;
+	memset(broad_pickups, BROAD_NONE, sizeof(broad_pickups));
+	memset(broad_fireworks, BROAD_NONE, sizeof(broad_fireworks));
+	for (m = game.cheese_pool.live; m; ) broad_insert(broad_pickups, pool_pop(&m));
+	for (m = game.trap_pool.live; m; ) broad_insert(broad_pickups, BROAD_TRAP0 + pool_pop(&m));
+	if (game.door_active) broad_insert(broad_pickups, BROAD_DOOR);
+	if (game.milk_active) broad_insert(broad_pickups, BROAD_MILK);
+	for (m = game.firework_pool.live; m; ) broad_insert(broad_fireworks, BROAD_FIREWORK0 + pool_pop(&m));
+}
+
+/*
+**	Collect ids from the cells that could overlap obj, in ascending order.
+**  Corners are binned, so the search reaches BROAD_REACH px up and left.
+**  Returns how many ids were written to out.
+*/
+uint8_t broad_query(uint8_t heads[], Object* obj, uint8_t out[]) {
+	int x = REAL_INT(obj->pos.x), y = REAL_INT(obj->pos.y);
+	int c1 = broad_clamp((x - BROAD_REACH + 1) / BROAD_CELL, BROAD_COLS - 1);
+	int r1 = broad_clamp((y - BROAD_REACH + 1) / BROAD_CELL, BROAD_ROWS - 1);
+	int c2 = broad_clamp((x + OBJ_W(obj) - 1) / BROAD_CELL, BROAD_COLS - 1);
+	int r2 = broad_clamp((y + OBJ_H(obj) - 1) / BROAD_CELL, BROAD_ROWS - 1);
+	uint8_t n = 0;
+
+	for (int r = r1; r <= r2; r++) {
+		for (int c = c1; c <= c2; c++) {
+			for (uint8_t id = heads[r * BROAD_COLS + c]; id != BROAD_NONE; id = broad_next[id]) {
+				// Insertion sort keeps the original resolve order
+				uint8_t k = n++;
+				while (k > 0 && out[k-1] > id) {
+					out[k] = out[k-1];
+					k--;
+				}
+				out[k] = id;
+			}
+		}
+	}
+	return n;
 }
 
 void  do_collisions() {
+	uint8_t near[BROAD_IDS];
+	uint8_t n;
+
+	broad_rebuild();
 
 	// Jerry and Tom 
 	if (obj_collided(&jerry.data.obj, &tom.data.obj)) {
@@ -1159,53 +2041,55 @@ void  do_collisions() {
 		reset_position(&tom.data);
 	}
 
-	// Jerry and cheese
-	for (int i = 0; i < MAX_CHEESE; i++) {
-		if (game.cheese[i].active == 1 && obj_collided(&jerry.data.obj, &game.cheese[i])) {
+	// Jerry and cheese, traps, door, milk
+	n = broad_query(broad_pickups, &jerry.data.obj, near);
+	for (uint8_t k = 0; k < n; k++) {
+		uint8_t id = near[k];
+		Object* obj = broad_object(id);
+		if (!broad_live(id) || !obj_collided(&jerry.data.obj, obj)) continue;
+
+		if (id < BROAD_TRAP0) {
 			jerry.score++;
 			game.cheese_count++;				
 			game.cheese_count_level++;
-			game.cheese[i].active = 0;
-			game.cheese_timer = get_current_time();
+			pool_release(&game.cheese_pool, id);
+			grid_mark_object(obj, -1);
+			wheel_schedule(EV_CHEESE, now_ms + CHEESE_MS);
 		}
-	}
-
-	// Jerry and traps
-	for (int i = 0; i < MAX_TRAPS; i++) {
-		if (game.traps[i].active == 1 && obj_collided(&jerry.data.obj, &game.traps[i]) && game.super_mode == 0) {
-			jerry.lives--;
-			game.traps[i].active = 0;
-			game.trap_timer = get_current_time(); 
+		else if (id < BROAD_DOOR) {
+			if (game.super_mode == 0) {
+				jerry.lives--;
+				pool_release(&game.trap_pool, id - BROAD_TRAP0);
+				grid_mark_object(obj, -1);
+				wheel_schedule(EV_TRAP, now_ms + TRAP_MS);
+			}
 		}
-	}	
-
-	// Jerry and door
-	if(game.door.active == 1 && obj_collided(&jerry.data.obj, &game.door)) {
-		//turnOnLed0(1);
-		if(game.level == 1) {
-			game.level = 2;
-			reset_game();
-			load_room();
-		} else {
-			game_state=GAMEOVER;
+		else if (id == BROAD_DOOR) {
+			//turnOnLed0(1);
+			if(game.level == 1) {
+				game.level = 2;
+				reset_game();
+				load_room();
+			} else {
+				game_state=GAMEOVER;
+			}
+		}
+		else {
+			game.milk_active =0 ;
+			grid_mark_object(&game.milk, -1);
+			make_super();
 		}
-	}
-
-	// Jerry and milk
-	if(game.milk.active == 1 && obj_collided(&jerry.data.obj, &game.milk)) {
-		game.milk.active =0 ;
-		make_super();
 	}
 
 	// Tom and firework
-	for (int i = 0; i < MAX_FIREWORKS; i++) {
-		if (game.fireworks[i].obj.active == 1 && obj_collided(&tom.data.obj, &game.fireworks[i].obj)) {
+	n = broad_query(broad_fireworks, &tom.data.obj, near);
+	for (uint8_t k = 0; k < n; k++) {
+		if (broad_live(near[k]) && obj_collided(&tom.data.obj, broad_object(near[k]))) {
 			jerry.score++;
 			reset_position(&tom.data);
 			// Clear fireworks
-			for (int i = 0; i < MAX_FIREWORKS; i++) {
-				game.fireworks[i].obj.active = 0;
-			}
+			pool_init(&game.firework_pool, game.firework_free, MAX_FIREWORKS);
+			break;
 		}
 	}
 
@@ -1215,58 +2099,41 @@ void  do_collisions() {
 
 void move_tom() {
 
-	int new_x = tom.data.obj.pos.x + tom.data.d.x;
-	int new_y = tom.data.obj.pos.y + tom.data.d.y;	
+	int new_x = REAL_INT(tom.data.obj.pos.x + tom.data.d.x);
+	int new_y = REAL_INT(tom.data.obj.pos.y + tom.data.d.y);	
 
 	// Check horizontal game area bounds
-	if(new_x < 0 || new_x > LCD_X-tom.data.obj.w) {
+	if(new_x < 0 || new_x > LCD_X-OBJ_W(&tom.data.obj)) {
 		rand_direction(&tom.data, 1, 0); // Randomise x-bounce direction
-		new_x = tom.data.obj.pos.x + tom.data.d.x;
-		if(new_x < 0 || new_x > LCD_X-tom.data.obj.w) tom.data.d.x = -tom.data.d.x;
+		new_x = REAL_INT(tom.data.obj.pos.x + tom.data.d.x);
+		if(new_x < 0 || new_x > LCD_X-OBJ_W(&tom.data.obj)) tom.data.d.x = -tom.data.d.x;
 	}
 
 	// Check vertical game area bounds
-	if(new_y < GAME_CEILING || new_y > LCD_Y - tom.data.obj.h) {
+	if(new_y < GAME_CEILING || new_y > LCD_Y - OBJ_H(&tom.data.obj)) {
 		rand_direction(&tom.data, 0, 1); // Randomise y-bounce direction
-		new_y = tom.data.obj.pos.y + tom.data.d.y;
-		if(new_y < GAME_CEILING || new_y > LCD_Y - tom.data.obj.h) tom.data.d.y = -tom.data.d.y;
+		new_y = REAL_INT(tom.data.obj.pos.y + tom.data.d.y);
+		if(new_y < GAME_CEILING || new_y > LCD_Y - OBJ_H(&tom.data.obj)) tom.data.d.y = -tom.data.d.y;
 	}
 
-	// Check for walls on the right
-	if(tom.data.d.x > 0) {
-		if(collide_bitmap_wall(new_x + tom.data.obj.w-1, new_y, new_x + tom.data.obj.w-1, new_y + tom.data.obj.h-1, BT)) {
-			rand_direction(&tom.data, 1, 0); // Randomise x-bounce direction
-			new_x = tom.data.obj.pos.x + tom.data.d.x;
-			if(collide_bitmap_wall(new_x + tom.data.obj.w-1, new_y, new_x + tom.data.obj.w-1, new_y + tom.data.obj.h-1, BT))
-				tom.data.d.x = -tom.data.d.x;
-		}
-	}
-	// Check for walls on the left	
-	if(tom.data.d.x < 0) {
-		if(collide_bitmap_wall(new_x, new_y, new_x, new_y + tom.data.obj.h-1, BT)) {
-			rand_direction(&tom.data, 1, 0); // Randomise x-bounce direction
-			new_x = tom.data.obj.pos.x + tom.data.d.x;
-			if(collide_bitmap_wall(new_x, new_y, new_x, new_y + tom.data.obj.h-1, BT))
-				tom.data.d.x = -tom.data.d.x;			
-		}		
-	}
-	// Check for walls below	
-	if(tom.data.d.y > 0) {
-		if(collide_bitmap_wall(new_x, new_y + tom.data.obj.h-1, new_x + tom.data.obj.w-1, new_y + tom.data.obj.h-1, LR)) {
-			rand_direction(&tom.data, 0, 1); // Randomise y-bounce direction
-			new_y = tom.data.obj.pos.y + tom.data.d.y;
-			if(collide_bitmap_wall(new_x, new_y + tom.data.obj.h-1, new_x + tom.data.obj.w-1, new_y + tom.data.obj.h-1, LR))
-				tom.data.d.y = -tom.data.d.y;
-		}	
+	// One query gives every blocked side
+	uint8_t blocked = wall_sides(new_x, new_y, OBJ_W(&tom.data.obj), OBJ_H(&tom.data.obj));
+
+	// Check for walls on the right or left
+	if((tom.data.d.x > 0 && (blocked & WALL_RIGHT)) || (tom.data.d.x < 0 && (blocked & WALL_LEFT))) {
+		rand_direction(&tom.data, 1, 0); // Randomise x-bounce direction
+		new_x = REAL_INT(tom.data.obj.pos.x + tom.data.d.x);
+		blocked = wall_sides(new_x, new_y, OBJ_W(&tom.data.obj), OBJ_H(&tom.data.obj));
+		if((tom.data.d.x > 0 && (blocked & WALL_RIGHT)) || (tom.data.d.x < 0 && (blocked & WALL_LEFT)))
+			tom.data.d.x = -tom.data.d.x;
 	}
-	// Check for walls above
-	if(tom.data.d.y < 0) {
-		if(collide_bitmap_wall(new_x, new_y, new_x + tom.data.obj.w-1, new_y, LR)) {
-			rand_direction(&tom.data, 0, 1); // Randomise y-bounce direction
-			new_y = tom.data.obj.pos.y + tom.data.d.y;
-			if(collide_bitmap_wall(new_x, new_y, new_x + tom.data.obj.w-1, new_y, LR))
-				tom.data.d.y = -tom.data.d.y;			
-		}
+	// Check for walls below or above
+	if((tom.data.d.y > 0 && (blocked & WALL_BOTTOM)) || (tom.data.d.y < 0 && (blocked & WALL_TOP))) {
+		rand_direction(&tom.data, 0, 1); // Randomise y-bounce direction
+		new_y = REAL_INT(tom.data.obj.pos.y + tom.data.d.y);
+		blocked = wall_sides(new_x, new_y, OBJ_W(&tom.data.obj), OBJ_H(&tom.data.obj));
+		if((tom.data.d.y > 0 && (blocked & WALL_BOTTOM)) || (tom.data.d.y < 0 && (blocked & WALL_TOP)))
+			tom.data.d.y = -tom.data.d.y;
 	}
 
 	// Move Tom
@@ -1275,118 +2142,129 @@ void move_tom() {
 }
 
 void move_fireworks() {
-	for (int i = 0; i < MAX_FIREWORKS; i++) {
-		if (game.fireworks[i].obj.active == 1) {
-
-			// Direction from firework to tom
-			float dir = get_direction(game.fireworks[i].obj.pos.x, game.fireworks[i].obj.pos.y, tom.data.obj.pos.x, tom.data.obj.pos.y);
-
-			// Calc delta
-			game.fireworks[i].d.x = FW_SPEED * cos(dir);
-			game.fireworks[i].d.y = -FW_SPEED * sin(dir);            
-
-			game.fireworks[i].obj.pos.x = game.fireworks[i].obj.pos.x + game.fireworks[i].d.x;
-			game.fireworks[i].obj.pos.y = game.fireworks[i].obj.pos.y + game.fireworks[i].d.y;
-
-			// Check for walls
-			if(check_wall((int)game.fireworks[i].obj.pos.x, (int)game.fireworks[i].obj.pos.y)) {
-				game.fireworks[i].obj.active = 0;
-			}
+	for (uint32_t m = game.firework_pool.live; m; ) {
+		int i = pool_pop(&m);
+		// Direction from firework to tom
+		angle_t dir = get_direction(game.fireworks[i].pos.x, game.fireworks[i].pos.y, tom.data.obj.pos.x, tom.data.obj.pos.y);
+
+		// Calc delta
+		game.fireworks[i].pos.x += REAL_MUL(FLOAT_TO_REAL(FW_SPEED), cos_real(dir));
+		game.fireworks[i].pos.y -= REAL_MUL(FLOAT_TO_REAL(FW_SPEED), sin_real(dir));
+
+		// Check for walls
+		if(check_wall(REAL_INT(game.fireworks[i].pos.x), REAL_INT(game.fireworks[i].pos.y))) {
+			pool_release(&game.firework_pool, i);
 		}
-
 	}	
 }
 
+// EV_TRAP: Tom drops a trap
 void process_traps() {
-	if (get_current_time() - game.trap_timer >= 3) {
-
-		for (int i = 0; i < MAX_TRAPS; i++) {
-			if (game.traps[i].active == 0) {
-				game.traps[i].active = 1;
-				game.traps[i].pos.x = tom.data.obj.pos.x + tom.data.obj.w/2;
-				game.traps[i].pos.y = tom.data.obj.pos.y + tom.data.obj.h/2;
-				game.traps[i].w = SM_OBJ_WIDTH;
-				game.traps[i].h = SM_OBJ_HEIGHT;
-				game.traps[i].bitmap = trap_direct;
-				game.trap_timer = get_current_time();
-				return;
-			}
-		}
+	int i = pool_alloc(&game.trap_pool);
+	if (i >= 0) {
+		game.traps[i].pos.x = tom.data.obj.pos.x + TO_REAL(OBJ_W(&tom.data.obj)/2);
+		game.traps[i].pos.y = tom.data.obj.pos.y + TO_REAL(OBJ_H(&tom.data.obj)/2);
+		game.traps[i].sprite = SPR_TRAP;
+		grid_mark_object(&game.traps[i], 1);
 	}
+	wheel_schedule(EV_TRAP, now_ms + TRAP_MS);
 }
 
+// EV_CHEESE: spawn a cheese somewhere clear
 void process_cheese() {
-	if (get_current_time() - game.cheese_timer >= 2) {
-
-		for (int i = 0; i < MAX_CHEESE; i++) {
-			if (game.cheese[i].active == 0) {
-				//game.cheese[i].active = 1;
-				game.cheese[i].w = SM_OBJ_WIDTH;
-				game.cheese[i].h = SM_OBJ_HEIGHT;
-				find_clear(&game.cheese[i]);
-				game.cheese[i].active=1;
-				game.cheese[i].bitmap = cheese_direct;			
-				game.cheese_timer = get_current_time();
-				return;
-			}
-		}
+	int i = pool_alloc(&game.cheese_pool);
+	if (i >= 0) {
+		game.cheese[i].sprite = SPR_CHEESE;
+		if(find_clear(&game.cheese[i])) grid_mark_object(&game.cheese[i], 1);
+		else pool_release(&game.cheese_pool, i);
 	}
+	wheel_schedule(EV_CHEESE, now_ms + CHEESE_MS);
 }
 
 void draw_cheese() {
-	process_cheese();
-
-	for (int i = 0; i < MAX_CHEESE; i++) {
-		if (game.cheese[i].active == 1) draw_data(&game.cheese[i],game.cheese[i].bitmap);
+	for (uint32_t m = game.cheese_pool.live; m; ) {
+		int i = pool_pop(&m);
+		draw_data(&game.cheese[i]);
 	}
 }
 
 void draw_traps() {
-	process_traps();
-	for (int i = 0; i < MAX_TRAPS; i++) {
-		if (game.traps[i].active == 1) draw_data(&game.traps[i], game.traps[i].bitmap);
+	for (uint32_t m = game.trap_pool.live; m; ) {
+		int i = pool_pop(&m);
+		draw_data(&game.traps[i]);
 	}
 }
 
 void draw_fireworks() {
-	for (int i = 0; i < MAX_FIREWORKS; i++) {
-		if (game.fireworks[i].obj.active == 1) draw_data(&game.fireworks[i].obj, game.fireworks[i].obj.bitmap);
+	for (uint32_t m = game.firework_pool.live; m; ) {
+		int i = pool_pop(&m);
+		draw_data(&game.fireworks[i]);
 	}
 }
 
 void draw_door() {
-	if(game.cheese_count_level == 5 && game.door.active == 0) {
-		game.door.w = MD_OBJ_WIDTH;
-		game.door.h = MD_OBJ_HEIGHT;
-		find_clear(&game.door);		
-		game.door.active = 1;		
-		game.door.bitmap = door_direct;
+	if(game.cheese_count_level == 5 && game.door_active == 0) {
+		game.door.sprite = SPR_DOOR;
+		if(find_clear(&game.door)) {
+			game.door_active = 1;
+			grid_mark_object(&game.door, 1);
+		}
 	}
-	if(game.door.active == 1) draw_data(&game.door, game.door.bitmap);
+	if(game.door_active == 1) draw_data(&game.door);
 
 }
 
+// EV_MILK: move the milk somewhere clear
+void process_milk() {
+	game.milk.sprite = SPR_MILK;
+	if(game.milk_active == 1) grid_mark_object(&game.milk, -1);
+	game.milk_active = find_clear(&game.milk);
+	if(game.milk_active == 1) grid_mark_object(&game.milk, 1);
+	wheel_schedule(EV_MILK, now_ms + MILK_MS);
+}
+
 void draw_milk() {
-	if(get_current_time() - game.milk_timer >= 5) {
-		game.milk.w = 6;
-		game.milk.h = SM_OBJ_HEIGHT;
-		find_clear(&game.milk);		
-		game.milk.active = 1;		
-		game.milk.bitmap = milk_direct;
-		game.milk_timer = get_current_time();
-	}
-	if(game.milk.active == 1) draw_data(&game.milk, game.milk.bitmap);
+	if(game.milk_active == 1) draw_data(&game.milk);
 }
 
+// EV_SUPER: count super mode down a second at a time
 void check_super() {
-	if(game.super_mode == 1 && get_current_time() > game.super_timer + 10) {
-		game.super_mode = 0;
-		jerry.data.obj.bitmap = jerry_direct;
-		jerry.data.obj.w = CHAR_WIDTH;
-		jerry.data.obj.h = CHAR_HEIGHT;
+	if (++supertimer * SUPER_STEP_MS >= SUPER_MS) clear_super();
+	else wheel_schedule(EV_SUPER, wheel_deadline[EV_SUPER] + SUPER_STEP_MS);
+}
+
+void wheel_fire(uint8_t ev) {
+	switch (ev) {
+		case EV_CHEESE: process_cheese(); break;
+		case EV_TRAP: process_traps(); break;
+		case EV_MILK: process_milk(); break;
+		case EV_SUPER: check_super(); break;
 	}
-	if(game.super_mode == 1) {
-		supertimer = get_current_time() - game.super_timer;
+}
+
+/*
+**  Fire every event due by now. Walks the slots from the last one
+**  scanned up to the current one; events in a slot that belong to a
+**  later lap of the wheel stay put. A handler may reschedule itself.
+*/
+void wheel_run(uint32_t now) {
+	uint32_t tick = now >> WHEEL_SHIFT;
+	if (tick - wheel_tick >= WHEEL_SLOTS) wheel_tick = tick - (WHEEL_SLOTS - 1); // one lap covers them all
+
+	for (;;) {
+		uint8_t* link = &wheel_head[wheel_tick & (WHEEL_SLOTS - 1)];
+		while (*link != WHEEL_NONE) {
+			uint8_t ev = *link;
+			if ((int32_t)(wheel_deadline[ev] - now) > 0) {
+				link = &wheel_next[ev];
+				continue;
+			}
+			*link = wheel_next[ev];
+			wheel_slot[ev] = WHEEL_NONE;
+			wheel_fire(ev);
+		}
+		if (wheel_tick == tick) break;
+		wheel_tick++;
 	}
 }
 
@@ -1395,31 +2273,36 @@ void check_super() {
 */
 void draw_status_bar(void) {
 
-	int time = get_current_time();
-	draw_formatted( 0, 1, buffer, sizeof(buffer), "L%d h%d s%d T%.2d:%.2d",game.level, jerry.lives,jerry.score, time_min,time );	
+	uint16_t time = now_ms / 1000;
+	draw_formatted( 0, 1, buffer, sizeof(buffer), "L%d h%d s%d T%.2d:%.2d",game.level, jerry.lives,jerry.score, time / 60, time % 60 );	
+
+	// Only resend the text when it changed
+	if (strcmp(buffer, drawn_status) != 0) {
+		dirty_mark(0, 0, LCD_X, GAME_CEILING - 1);
+		strcpy(drawn_status, buffer);
+	}
 
 	// Draw separator line
 	draw_line(0, GAME_CEILING-1, LCD_X, GAME_CEILING-1, BG_COLOUR);
 }
 
-void wait_sw_r(void) {
-	static uint8_t prev_b_right = 0;	
+// Block until a fresh press of the given input
+void wait_press(uint8_t input) {
+	InputEvent ev;
+	input_flush();
 	while (1){
-		// if ((PINF>>5) & 0b1){
-		// 	break;
-		// }
-		if(sw_b_right != prev_b_right) break;
-	}	
+		if(input_pop(&ev) && ev.input == input && ev.pressed) break;
+		hal_idle();
+	}
+	input_waiting = 0;
+}
+
+void wait_sw_r(void) {
+	wait_press(IN_B_RIGHT);
 }
 
 void wait_sw_l(void) {
-	static uint8_t prev_b_left = 0;	
-	while (1){
-		// if ((PINF>>6) & 0b1){
-		// 	break;
-		// }
-		if(sw_b_left != prev_b_left) break;
-	}	
+	wait_press(IN_B_LEFT);
 }
 
 void draw_welcome_screen() {
@@ -1522,18 +2405,19 @@ void setup_timer1(void) {
 //setup a 16bit timer
 void setup_timer3(void) {
 
-	   // Timer 3 in normal mode (WGM32. WGM33), 
-		// with pre-scaler 256 ==> 	(CS32,CS31,CS30).
-		// Timer overflow on. (TOIE3)
+	   // Timer 3 in CTC mode (WGM32), 
+		// with pre-scaler 64 ==> 	(CS32,CS31,CS30).
+		// Compare match A every TICKS_PER_MS counts = 1 ms. (OCIE3A)
 
-		CLEAR_BIT(TCCR3B,WGM32);
+		SET_BIT(TCCR3B,WGM32);
 		CLEAR_BIT(TCCR3B,WGM33);
-		SET_BIT(TCCR3B,CS32);     //1 see table 14-6
-		CLEAR_BIT(TCCR3B,CS31);   //0
-		SET_BIT(TCCR3B,CS30);   //0
+		OCR3A = TICKS_PER_MS - 1;
+		CLEAR_BIT(TCCR3B,CS32);     //0 see table 14-6
+		SET_BIT(TCCR3B,CS31);   //1
+		SET_BIT(TCCR3B,CS30);   //1
 		
-		//enabling the timer overflow interrupt
-		SET_BIT(TIMSK3, TOIE3);
+		//enabling the compare match interrupt
+		SET_BIT(TIMSK3, OCIE3A);
 
 }
 
@@ -1552,17 +2436,32 @@ void setup_controller() {
 	DDRF &= ~(1 << 1); // ADC1 - Right wheel
 }
 
+// Free-running ADC, alternating ADC0/ADC1 from the ADC interrupt
+void setup_adc(void) {
+	SET_BIT(ADMUX, REFS0); // AVcc reference, channel 0
+	CLEAR_BIT(ADMUX, ADLAR);
+	adc_channel = 0;
+	adc_skip = 1;
+
+	ADCSRB = 0; // auto trigger source: free running (ADTS = 0)
+	SET_BIT(ADCSRA, ADPS2); // pre-scaler 128 ==> 62.5kHz ADC clock
+	SET_BIT(ADCSRA, ADPS1);
+	SET_BIT(ADCSRA, ADPS0);
+	SET_BIT(ADCSRA, ADATE);
+	SET_BIT(ADCSRA, ADIE);
+	SET_BIT(ADCSRA, ADEN);
+	SET_BIT(ADCSRA, ADSC); // first conversion starts the chain
+}
+
 // Generate seed based on ADC values and time
 uint8_t generateSeed() {
 	int seed = 0;
-	int left_adc = adc_read(0);
-	int right_adc = adc_read(1);	
-	duty_cycle_r = (int)254.0 * (right_adc/1023.0);
-	duty_cycle_l = (int)254.0 * (left_adc/1023.0);
+	while (adc_ready != 0b11) hal_idle(); // both wheels read once, a few ms
 	seed = duty_cycle_r+duty_cycle_l;
+	seed += adc_entropy;
 	seed += overflow_counter0;
 	seed += overflow_counter1;
-	seed += overflow_counter3;
+	seed += clock_millis();
 	return seed;
 }
 
@@ -1590,12 +2489,84 @@ void setup(void) {
 	clear_screen();
 
 	//init ADC
-	adc_init();	
+	setup_adc();	
 	srand(generateSeed());	// Configures USB	
-	setup_bitmaps();
 	game_state=WELCOME;	
 }
 
+uint8_t tx_free() {
+	return (tx_tail - tx_head - 1) & (TX_RING - 1);
+}
+
+void tx_put(uint8_t byte, uint16_t* crc) {
+	tx_ring[tx_head] = byte;
+	tx_head = (tx_head + 1) & (TX_RING - 1);
+	if (crc) *crc = _crc_ccitt_update(*crc, byte);
+}
+
+// Hand queued bytes to the USB stack until its buffer is full
+void tx_flush() {
+	while (tx_tail != tx_head && usb_serial_putchar_nowait(tx_ring[tx_tail]) == 0) {
+		tx_tail = (tx_tail + 1) & (TX_RING - 1);
+	}
+}
+
+/*
+**  Queue a telemetry frame holding the fields that changed since the
+**  last one (or all of them every TELEMETRY_FULL frames, so a host can
+**  join at any time). Never blocks: if the ring has no room the frame
+**  is dropped and its changes go out with the next one.
+*/
+void send_telemetry() {
+	uint16_t values[TM_COUNT];
+	values[TM_TIME] = now_ms / 1000;
+	values[TM_LEVEL] = game.level;
+	values[TM_SCORE] = jerry.score;
+	values[TM_LIVES] = jerry.lives;
+	values[TM_FIREWORKS] = POOL_COUNT(game.firework_pool);
+	values[TM_CHEESE] = POOL_COUNT(game.cheese_pool);
+	values[TM_TRAPS] = POOL_COUNT(game.trap_pool);
+	values[TM_CHEESE_ROOM] = game.cheese_count_level;
+	values[TM_SUPER] = game.super_mode;
+	values[TM_PAUSED] = game_state == PAUSE;
+	values[TM_SPAWN_MAX] = spawn_latency_max;
+	values[TM_INPUT_MAX] = input_latency_max;
+	values[TM_INPUT_LOST] = input_dropped;
+	values[TM_TX_LOST] = tm_lost;
+	values[TM_ROOM_ERRORS] = room_errors;
+
+	uint16_t mask = 0;
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < TM_COUNT; i++) {
+		if (tm_seq % TELEMETRY_FULL == 0 || values[i] != tm_sent[i]) {
+			mask |= 1 << i;
+			count++;
+		}
+	}
+
+	uint8_t length = 3 + count * 2; // seq, mask, values
+	if (tx_free() < length + 4) { // + sync, length, crc
+		tm_lost++;
+		return;
+	}
+
+	uint16_t crc = 0xFFFF;
+	tx_put(TELEMETRY_SYNC, NULL);
+	tx_put(length, &crc);
+	tx_put(tm_seq++, &crc);
+	tx_put(mask, &crc);
+	tx_put(mask >> 8, &crc);
+	for (uint8_t i = 0; i < TM_COUNT; i++) {
+		if (mask & (1 << i)) {
+			tx_put(values[i], &crc);
+			tx_put(values[i] >> 8, &crc);
+			tm_sent[i] = values[i];
+		}
+	}
+	tx_put(crc, NULL);
+	tx_put(crc >> 8, NULL);
+}
+
 void process(void) {
 	// int16_t char_code = usb_serial_getchar();
 
@@ -1604,16 +2575,18 @@ void process(void) {
 	// 	usb_serial_send( buffer );
 	// }
 	clear_screen();	
+	now_ms = clock_millis();
 
 	// turnOffLed0(1);
 	// turnOffLed0(2);
-	check_super();
 	process_input();    
+	room_poll();
+	run_wall_ticks();
 	if(game_state != PAUSE) move_tom();
 	move_fireworks();	
-	//move_walls();
 
 	do_collisions();
+	if(game_state != PAUSE) wheel_run(now_ms);
 
 	draw_walls();
 	draw_cheese();
@@ -1622,54 +2595,17 @@ void process(void) {
 	draw_fireworks();
 	draw_milk();	
 
-	draw_data(&tom.data.obj, tom.data.obj.bitmap);
-	draw_data(&jerry.data.obj, jerry.data.obj.bitmap);
+	draw_data(&tom.data.obj);
+	draw_data(&jerry.data.obj);
 	
-	if(game.level == 2) {
-		char tx_buffer[32];
-		sprintf(tx_buffer, "Time: %.2d:%.2d\n",time_min, get_current_time());
-		usb_serial_send( tx_buffer );
-		sprintf(tx_buffer, "Level: %d\n",game.level);
-		usb_serial_send( tx_buffer );		
-		sprintf(tx_buffer, "Score: %d\n",jerry.score);
-		usb_serial_send( tx_buffer );
-		int count=0;
-		for(int i= 0; i < MAX_FIREWORKS; i++) {
-			if(game.fireworks[i].obj.active == 1) count++;
-		}
-		sprintf(tx_buffer, "Fireworks: %d\n",count);
-		usb_serial_send( tx_buffer );
-
-		for(int i= 0; i < MAX_CHEESE; i++) {
-			if(game.cheese[i].active == 1) count++;
-		}		
-		sprintf( tx_buffer, "Cheese: %d\n", count );		
-		usb_serial_send( tx_buffer );
-
-		for(int i= 0; i < MAX_TRAPS; i++) {
-			if(game.traps[i].active == 1) count++;
-		}		
-		sprintf( tx_buffer, "Traps: %d\n", count );
-		usb_serial_send( tx_buffer );
-
-		sprintf( tx_buffer, "Cheese cur room: %d\n", game.cheese_count_level);
-		usb_serial_send( tx_buffer);
-
-		sprintf( tx_buffer, "Super mode: %d\n", game.super_mode);
-		usb_serial_send(tx_buffer);
-
-		int paused=0;
-		if(game_state == PAUSE) paused = 1; 
-		sprintf( tx_buffer, "Paused: %d\n", paused);
-		usb_serial_send(tx_buffer);		
+	if(game.level == 2 && ++tm_frames >= TELEMETRY_EVERY) {
+		tm_frames = 0;
+		send_telemetry();
 	}
+	tx_flush();
 	draw_status_bar();
 
-	//duty cycle is adjusted with the potentiometer 
-	int left_adc = adc_read(0);
-	int right_adc = adc_read(1);
-	duty_cycle_r = (int)254.0 * (right_adc/1023.0);
-	duty_cycle_l = (int)254.0 * (left_adc/1023.0);
+	//duty cycle is adjusted with the potentiometer, see ISR(ADC_vect)
 
 	//add logic to cycle the variable duty_cycle from 0 - TOP - 0
 	// //that would gradually dim the LED
@@ -1677,8 +2613,14 @@ void process(void) {
 	// draw_formatted(15,24, buffer, sizeof(buffer), "%d", duty_cycle_r );	
 	// draw_formatted(15,34, buffer, sizeof(buffer), "%d", duty_cycle_l );	
 
-	show_screen();	
-		
+	show_dirty();	
+
+	// Input to photon: oldest press handled this frame until it is on the LCD
+	if (input_waiting) {
+		uint16_t latency = clock_millis() - input_stamp;
+		if (latency > input_latency_max) input_latency_max = latency;
+		input_waiting = 0;
+	}
 }
 
 int main(void) {
@@ -1692,5 +2634,6 @@ int main(void) {
 		} else if (game_state == GAMEOVER) {
 			draw_gameover_screen();
 		}
+		hal_frame();
 	}
 }
\ No newline at end of file